@@ -0,0 +1,158 @@
+#include "adaptive_execution.h"
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include "concurrent_map.h"
+#include "thread_pool.h"
+
+using namespace std;
+
+atomic<int> ExecutionCostModel::active_parallel_calls = 0;
+
+namespace
+{
+    const size_t CALIBRATION_SMALL_SIZE = 256;
+    const size_t CALIBRATION_LARGE_SIZE = 32768;
+    const int CALIBRATION_RUNS = 5;
+
+    using Clock = chrono::steady_clock;
+
+    map<int, double> MakeCalibrationPostings(size_t size)
+    {
+        map<int, double> postings;
+        for (size_t i = 0; i < size; i++)
+        {
+            postings.emplace(static_cast<int>(i * 7), 0.5);
+        }
+        return postings;
+    }
+    template <typename Run>
+    double MeasureBest(Run run)
+    {
+        double best = 0.0;
+        for (int i = 0; i < CALIBRATION_RUNS; i++)
+        {
+            const Clock::time_point start = Clock::now();
+            run();
+            const double elapsed = static_cast<double>(chrono::duration_cast<chrono::nanoseconds>(Clock::now() - start).count());
+            best = (i == 0) ? elapsed : min(best, elapsed);
+        }
+        return best;
+    } // Minimum of several runs filters out scheduling noise
+
+    double MeasureSequential(const map<int, double>& postings)
+    {
+        return MeasureBest([&postings]()
+            {
+                map<int, double> relevance;
+                for (const auto& [id, tf] : postings)
+                {
+                    relevance[id] += 1.5 * tf;
+                }
+            });
+    }
+    double MeasureParallel(const map<int, double>& postings, ThreadPool& pool)
+    {
+        vector<map<int, double>::const_iterator> bounds;
+        for (auto it = postings.begin(); it != postings.end(); it = next(it, min<size_t>(DEFAULT_PARALLEL_GRAIN_SIZE, distance(it, postings.end()))))
+        {
+            bounds.push_back(it);
+        }
+        bounds.push_back(postings.end());
+
+        // Threads of the pool may be started by the first run, which the minimum filters out
+        return MeasureBest([&bounds, &pool]()
+            {
+                ConcurrentMap<int, double> relevance(8);
+                pool.ParallelFor(bounds.size() - 1, [&](size_t chunk)
+                    {
+                        for (auto it = bounds[chunk]; it != bounds[chunk + 1]; ++it)
+                        {
+                            relevance[it->first].ref_to_value += 1.5 * it->second;
+                        }
+                    });
+                relevance.BuildOrdinaryMap();
+            });
+    }
+}
+
+ExecutionCostModel::ExecutionCostModel(ThreadPool& pool)
+{
+    cores = static_cast<int>(pool.GetThreadCount());
+    if (cores > 1)
+        Calibrate(pool); // Single thread never runs in parallel, see Plan
+}
+void ExecutionCostModel::Calibrate(ThreadPool& pool)
+{
+    struct Coefficients
+    {
+        double seq_ns_per_posting;
+        double par_ns_per_posting;
+        double par_dispatch_ns;
+    };
+    // Pools of the same size share the coefficients, so only the first server with such a pool pays for the measurement.
+    // Mutex is held while measuring: the others wait for the result, and two measurements never skew each other
+    static mutex calibrations_mutex;
+    static map<int, Coefficients> calibrations; // [cores]
+    lock_guard guard(calibrations_mutex);
+    if (const auto calibrated = calibrations.find(cores); calibrated != calibrations.end())
+    {
+        seq_ns_per_posting = calibrated->second.seq_ns_per_posting;
+        par_ns_per_posting = calibrated->second.par_ns_per_posting;
+        par_dispatch_ns = calibrated->second.par_dispatch_ns;
+        return;
+    }
+
+    const map<int, double> small_postings = MakeCalibrationPostings(CALIBRATION_SMALL_SIZE);
+    const map<int, double> large_postings = MakeCalibrationPostings(CALIBRATION_LARGE_SIZE);
+
+    seq_ns_per_posting = MeasureSequential(large_postings) / CALIBRATION_LARGE_SIZE;
+
+    // Two sizes give both the fixed dispatch cost and the cost of every posting
+    const double par_small = MeasureParallel(small_postings, pool);
+    const double par_large = MeasureParallel(large_postings, pool);
+    par_ns_per_posting = max(0.0, (par_large - par_small) / (CALIBRATION_LARGE_SIZE - CALIBRATION_SMALL_SIZE));
+    par_dispatch_ns = max(0.0, par_small - par_ns_per_posting * CALIBRATION_SMALL_SIZE);
+    calibrations[cores] = { seq_ns_per_posting, par_ns_per_posting, par_dispatch_ns };
+}
+
+ExecutionPlan ExecutionCostModel::Plan(size_t posting_count) const
+{
+    return Plan(posting_count, GetActiveParallelCalls());
+}
+ExecutionPlan ExecutionCostModel::Plan(size_t posting_count, int active_calls) const
+{
+    ExecutionPlan plan;
+    if (cores == 1)
+        return plan;
+
+    // Every other parallel call in flight takes a share of the cores
+    const double idle_cores = max(1.0, static_cast<double>(cores - active_calls));
+    const double sequential_cost = seq_ns_per_posting * posting_count;
+    const double parallel_cost = par_dispatch_ns + par_ns_per_posting * posting_count * (cores / idle_cores);
+    plan.parallel = parallel_cost < sequential_cost;
+    if (!plan.parallel)
+        return plan;
+
+    // A few tasks per idle core, so uneven tasks still balance out
+    const size_t tasks_per_core = 4;
+    plan.grain_size = max(MIN_PARALLEL_GRAIN_SIZE, posting_count / (static_cast<size_t>(idle_cores) * tasks_per_core));
+    return plan;
+}
+
+ExecutionCostModel::ParallelCallGuard::ParallelCallGuard()
+{
+    active_parallel_calls.fetch_add(1, memory_order_relaxed);
+}
+ExecutionCostModel::ParallelCallGuard::~ParallelCallGuard()
+{
+    active_parallel_calls.fetch_sub(1, memory_order_relaxed);
+}
+int ExecutionCostModel::GetActiveParallelCalls()
+{
+    return active_parallel_calls.load(memory_order_relaxed);
+}
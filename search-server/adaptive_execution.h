@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+class ThreadPool;
+
+// Execution policy, that lets the server choose between sequential and parallel execution for every call,
+// using ExecutionCostModel. Used the same way as std::execution::seq and std::execution::par
+struct AdaptivePolicy
+{
+};
+inline constexpr AdaptivePolicy adaptive_policy{};
+
+struct ExecutionPlan
+{
+    bool parallel = false;
+    size_t grain_size = 0; // Postings per parallel task
+};
+
+// Linear cost model of the posting traversal:
+//     sequential = seq_ns_per_posting * postings
+//     parallel   = par_dispatch_ns + par_ns_per_posting * postings * (cores / idle cores)
+// Coefficients are calibrated by a micro benchmark, that runs the same kind of work as FindAllDocuments on the pool,
+// that parallel calls run on, so the threads and their pinning are the ones of the server. It runs once per pool size in the process
+class ExecutionCostModel
+{
+public:
+    explicit ExecutionCostModel(ThreadPool& pool); // Calibrates (about a hundred ms), unless the pool has a single thread or its size is calibrated already
+
+    ExecutionPlan Plan(size_t posting_count) const;
+    ExecutionPlan Plan(size_t posting_count, int active_parallel_calls) const;
+
+    double GetSequentialCost() const
+    {
+        return seq_ns_per_posting;
+    }
+    double GetParallelCost() const
+    {
+        return par_ns_per_posting;
+    }
+    double GetDispatchCost() const
+    {
+        return par_dispatch_ns;
+    }
+
+    // Parallel calls in flight, used as the current core load
+    class ParallelCallGuard
+    {
+    public:
+        ParallelCallGuard();
+        ~ParallelCallGuard();
+        ParallelCallGuard(const ParallelCallGuard&) = delete;
+        ParallelCallGuard& operator=(const ParallelCallGuard&) = delete;
+    };
+    static int GetActiveParallelCalls();
+
+private:
+    void Calibrate(ThreadPool& pool); // Reuses coefficients of a pool of the same size
+
+    double seq_ns_per_posting = 50.0;
+    double par_ns_per_posting = 50.0;
+    double par_dispatch_ns = 50000.0;
+    int cores = 1;
+
+    static std::atomic<int> active_parallel_calls;
+};
+
+const size_t MIN_PARALLEL_GRAIN_SIZE = 256;
+const size_t DEFAULT_PARALLEL_GRAIN_SIZE = 2048;
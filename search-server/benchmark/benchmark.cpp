@@ -0,0 +1,350 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <execution>
+#include <iostream>
+#include <fstream>
+#include <memory>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "corpus_generator.h"
+#include "search_server.h"
+#include "request_queue.h"
+#include "remove_duplicates.h"
+
+using namespace std;
+
+// Usage: search_server_benchmark [--documents N] [--min-length N] [--max-length N] [--vocabulary N] [--zipf X]
+//                                [--queries N] [--plus-words N] [--minus-words N] [--head-share X] [--seed N] [--memory-budget BYTES]
+//                                [--output FILE]
+// Prints results and memory of the index after ingestion as JSON to stdout, or to FILE when --output is given.
+
+struct BenchmarkOptions
+{
+    CorpusOptions corpus;
+    QueryOptions queries;
+    size_t memory_budget = UNLIMITED_MEMORY_BUDGET;
+    string output;
+};
+struct BenchmarkResult
+{
+    string name;
+    size_t operations = 0;
+    double total_seconds = 0.0;
+    double mean_ns = 0.0;
+    uint64_t p50_ns = 0;
+    uint64_t p90_ns = 0;
+    uint64_t p99_ns = 0;
+    uint64_t max_ns = 0;
+};
+struct BenchmarkReport
+{
+    vector<BenchmarkResult> results;
+    vector<pair<string, MemoryUsage>> memory; // [structure, usage]
+    bool forward_index = true;
+};
+
+using Clock = chrono::steady_clock;
+
+uint64_t ElapsedNanoseconds(Clock::time_point start)
+{
+    return static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(Clock::now() - start).count());
+}
+BenchmarkResult Summarize(string name, vector<uint64_t> latencies)
+{
+    BenchmarkResult result;
+    result.name = move(name);
+    result.operations = latencies.size();
+    if (latencies.empty())
+        return result;
+
+    sort(latencies.begin(), latencies.end());
+    const uint64_t total = accumulate(latencies.begin(), latencies.end(), uint64_t(0));
+    const auto percentile = [&latencies](double share)
+    {
+        return latencies[min(latencies.size() - 1, static_cast<size_t>(share * latencies.size()))];
+    };
+
+    result.total_seconds = total * 1e-9;
+    result.mean_ns = static_cast<double>(total) / latencies.size();
+    result.p50_ns = percentile(0.50);
+    result.p90_ns = percentile(0.90);
+    result.p99_ns = percentile(0.99);
+    result.max_ns = latencies.back();
+    return result;
+}
+template <typename Operation>
+BenchmarkResult Measure(string name, size_t count, Operation operation)
+{
+    vector<uint64_t> latencies;
+    latencies.reserve(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        const Clock::time_point start = Clock::now();
+        operation(i);
+        latencies.push_back(ElapsedNanoseconds(start));
+    }
+    return Summarize(move(name), move(latencies));
+} // Runs operation(i) for i in [0, count) and records latency of every call
+
+void PrintJson(ostream& out, const BenchmarkOptions& options, const BenchmarkReport& report)
+{
+    const vector<BenchmarkResult>& results = report.results;
+    out << "{\n";
+    out << "  \"options\": {\n";
+    out << "    \"documents\": " << options.corpus.document_count << ",\n";
+    out << "    \"min_length\": " << options.corpus.min_document_length << ",\n";
+    out << "    \"max_length\": " << options.corpus.max_document_length << ",\n";
+    out << "    \"vocabulary\": " << options.corpus.vocabulary_size << ",\n";
+    out << "    \"zipf\": " << options.corpus.zipf_exponent << ",\n";
+    out << "    \"queries\": " << options.queries.query_count << ",\n";
+    out << "    \"plus_words\": " << options.queries.plus_word_count << ",\n";
+    out << "    \"minus_words\": " << options.queries.minus_word_count << ",\n";
+    out << "    \"head_share\": " << options.queries.head_share << ",\n";
+    out << "    \"seed\": " << options.corpus.seed << ",\n";
+    out << "    \"memory_budget\": " << (options.memory_budget == UNLIMITED_MEMORY_BUDGET ? "null" : to_string(options.memory_budget)) << "\n";
+    out << "  },\n";
+    out << "  \"memory\": {\n";
+    out << "    \"forward_index\": " << (report.forward_index ? "true" : "false") << ",\n";
+    out << "    \"structures\": [\n";
+    for (size_t i = 0; i < report.memory.size(); i++)
+    {
+        const auto& [name, usage] = report.memory[i];
+        out << "      { \"name\": \"" << name << "\", \"bytes\": " << usage.bytes << ", \"allocations\": " << usage.allocations << " }"
+            << (i + 1 < report.memory.size() ? ",\n" : "\n");
+    }
+    out << "    ]\n";
+    out << "  },\n";
+    out << "  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const BenchmarkResult& result = results[i];
+        const double throughput = result.total_seconds > 0.0 ? result.operations / result.total_seconds : 0.0;
+        out << "    { \"name\": \"" << result.name << "\", \"operations\": " << result.operations
+            << ", \"total_seconds\": " << result.total_seconds << ", \"throughput_per_second\": " << throughput
+            << ", \"latency_ns\": { \"mean\": " << result.mean_ns << ", \"p50\": " << result.p50_ns << ", \"p90\": " << result.p90_ns
+            << ", \"p99\": " << result.p99_ns << ", \"max\": " << result.max_ns << " } }" << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n";
+    out << "}\n";
+}
+
+BenchmarkOptions ParseOptions(int argc, char* argv[])
+{
+    BenchmarkOptions options;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        const string name = argv[i];
+        const string value = argv[i + 1];
+        if (name == "--documents")
+            options.corpus.document_count = stoi(value);
+        else if (name == "--min-length")
+            options.corpus.min_document_length = stoi(value);
+        else if (name == "--max-length")
+            options.corpus.max_document_length = stoi(value);
+        else if (name == "--vocabulary")
+            options.corpus.vocabulary_size = stoi(value);
+        else if (name == "--zipf")
+            options.corpus.zipf_exponent = stod(value);
+        else if (name == "--queries")
+            options.queries.query_count = stoi(value);
+        else if (name == "--plus-words")
+            options.queries.plus_word_count = stoi(value);
+        else if (name == "--minus-words")
+            options.queries.minus_word_count = stoi(value);
+        else if (name == "--head-share")
+            options.queries.head_share = stod(value);
+        else if (name == "--seed")
+        {
+            options.corpus.seed = stoull(value);
+            options.queries.seed = options.corpus.seed + 1;
+        }
+        else if (name == "--memory-budget")
+            options.memory_budget = stoull(value);
+        else if (name == "--output")
+            options.output = value;
+        else
+            throw invalid_argument("Unknown option: " + name);
+    }
+    return options;
+}
+
+BenchmarkReport RunBenchmarks(const BenchmarkOptions& options)
+{
+    const vector<SyntheticDocument> corpus = GenerateCorpus(options.corpus);
+    const vector<string> queries = GenerateQueries(options.corpus, options.queries);
+    BenchmarkReport report;
+    vector<BenchmarkResult>& results = report.results;
+
+    SearchServer search_server(BENCHMARK_STOP_WORDS);
+    search_server.SetMemoryBudget(options.memory_budget);
+    results.push_back(Measure("add_document", corpus.size(), [&](size_t i)
+        {
+            search_server.AddDocument(corpus[i].id, corpus[i].text, corpus[i].status, corpus[i].ratings);
+        }));
+
+    const SearchServerMemoryStats memory = search_server.GetMemoryStats();
+    report.memory = {
+        { "documents", memory.documents },
+        { "forward_index", memory.forward_index },
+        { "dictionary", memory.dictionary },
+        { "stop_words", memory.stop_words },
+        { "doc_rating_status", memory.doc_rating_status },
+        { "ids", memory.ids },
+        { "segments", memory.segments },
+        { "total", memory.GetTotal() }
+    };
+    report.forward_index = search_server.HasForwardIndex();
+
+    results.push_back(Measure("find_top_documents_seq", queries.size(), [&](size_t i)
+        {
+            search_server.FindTopDocuments(execution::seq, queries[i]);
+        }));
+    results.push_back(Measure("find_top_documents_par", queries.size(), [&](size_t i)
+        {
+            search_server.FindTopDocuments(execution::par, queries[i]);
+        }));
+    results.push_back(Measure("find_top_documents_adaptive", queries.size(), [&](size_t i)
+        {
+            search_server.FindTopDocuments(adaptive_policy, queries[i]);
+        }));
+    results.push_back(Measure("find_top_documents_quantized", queries.size(), [&](size_t i)
+        {
+            search_server.FindTopDocuments(quantized_policy, queries[i]);
+        }));
+    // Deadline of the first one is never reached, the second one shows how well the deadline bounds the tail
+    results.push_back(Measure("find_top_documents_async", queries.size(), [&](size_t i)
+        {
+            SyncWait(search_server.FindTopDocumentsAsync(queries[i], chrono::steady_clock::now() + chrono::seconds(10)));
+        }));
+    results.push_back(Measure("find_top_documents_async_1ms", queries.size(), [&](size_t i)
+        {
+            SyncWait(search_server.FindTopDocumentsAsync(queries[i], chrono::steady_clock::now() + chrono::milliseconds(1)));
+        }));
+    results.push_back(Measure("find_top_documents_snippets", queries.size(), [&](size_t i)
+        {
+            search_server.FindTopDocumentsWithSnippets(queries[i]);
+        }));
+    results.push_back(Measure("find_top_documents_status", queries.size(), [&](size_t i)
+        {
+            search_server.FindTopDocuments(queries[i], DocumentStatus::BANNED);
+        }));
+    const DocumentFilter rating_filter = DocumentFilter::ForStatus(DocumentStatus::ACTUAL).WithRating(1, 10);
+    results.push_back(Measure("find_top_documents_filter", queries.size(), [&](size_t i)
+        {
+            search_server.FindTopDocuments(queries[i], rating_filter);
+        }));
+    // Allow-list of a contiguous id range, as a tenant or shard of the corpus would be
+    auto allowed_ids = make_shared<RoaringBitmap>();
+    for (size_t i = 0; i < corpus.size() / 8; i++)
+    {
+        allowed_ids->Add(static_cast<uint32_t>(corpus[i].id));
+    }
+    const DocumentFilter allow_list_filter = DocumentFilter().AllowIds(move(allowed_ids));
+    results.push_back(Measure("find_top_documents_allow_list", queries.size(), [&](size_t i)
+        {
+            search_server.FindTopDocuments(queries[i], allow_list_filter);
+        }));
+    results.push_back(Measure("find_top_documents_predicate", queries.size(), [&](size_t i)
+        {
+            search_server.FindTopDocuments(queries[i], [](int document_id, DocumentStatus /*status*/, int rating) { return document_id % 2 == 0 && rating > 0; });
+        }));
+
+    // Every keystroke of the first word of the query is a prefix, that the UI asks to complete
+    vector<string> prefixes;
+    vector<string> prefix_queries;
+    for (const string& query : queries)
+    {
+        const string_view word = SplitIntoWords(query).front();
+        for (size_t length = 1; length <= word.size(); length++)
+        {
+            prefixes.emplace_back(word.substr(0, length));
+        }
+        prefix_queries.push_back(string(word.substr(0, min<size_t>(word.size(), 2))) + '*' + query.substr(word.size()));
+    }
+    results.push_back(Measure("suggest", prefixes.size(), [&](size_t i)
+        {
+            search_server.Suggest(prefixes[i], 10);
+        }));
+    results.push_back(Measure("find_top_documents_prefix", prefix_queries.size(), [&](size_t i)
+        {
+            search_server.FindTopDocuments(prefix_queries[i]);
+        }));
+
+    // Typo in the first word of the query: one character is replaced, the rest of the query is kept
+    vector<string> fuzzy_queries;
+    for (const string& query : queries)
+    {
+        string word(SplitIntoWords(query).front());
+        word.back() = word.back() == 'z' ? 'a' : static_cast<char>(word.back() + 1);
+        fuzzy_queries.push_back(word + "~1" + query.substr(word.size()));
+    }
+    results.push_back(Measure("find_top_documents_fuzzy", fuzzy_queries.size(), [&](size_t i)
+        {
+            search_server.FindTopDocuments(fuzzy_queries[i]);
+        }));
+
+    results.push_back(Measure("match_document", queries.size(), [&](size_t i)
+        {
+            search_server.MatchDocument(queries[i], corpus[(i * 7919) % corpus.size()].id);
+        }));
+
+    RequestQueue request_queue(search_server);
+    results.push_back(Measure("request_queue_add_find_request", queries.size(), [&](size_t i)
+        {
+            request_queue.AddFindRequest(queries[i]);
+        }));
+    report.memory.push_back({ "request_queue", request_queue.GetMemoryUsage() });
+
+    // RemoveDuplicates reports every duplicate to cout, which would break the JSON
+    ostringstream duplicates_report;
+    streambuf* cout_buffer = cout.rdbuf(duplicates_report.rdbuf());
+    results.push_back(Measure("remove_duplicates", 1, [&](size_t)
+        {
+            RemoveDuplicates(search_server);
+        }));
+    cout.rdbuf(cout_buffer);
+
+    vector<int> ids_to_remove;
+    for (size_t i = 0; i < corpus.size(); i += 10)
+    {
+        ids_to_remove.push_back(corpus[i].id);
+    }
+    results.push_back(Measure("remove_document", ids_to_remove.size(), [&](size_t i)
+        {
+            search_server.RemoveDocument(ids_to_remove[i]);
+        }));
+    results.push_back(Measure("compact_removed_documents", 1, [&](size_t)
+        {
+            search_server.CompactRemovedDocuments();
+        }));
+
+    return report;
+}
+
+int main(int argc, char* argv[])
+{
+    try
+    {
+        const BenchmarkOptions options = ParseOptions(argc, argv);
+        const BenchmarkReport report = RunBenchmarks(options);
+
+        if (options.output.empty())
+            PrintJson(cout, options, report);
+        else
+        {
+            ofstream out(options.output);
+            PrintJson(out, options, report);
+        }
+    }
+    catch (const exception& e)
+    {
+        cerr << "Benchmark failed: " << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
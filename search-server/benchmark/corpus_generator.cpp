@@ -0,0 +1,114 @@
+#include "corpus_generator.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "string_processing.h"
+
+using namespace std;
+
+ZipfDistribution::ZipfDistribution(int size, double exponent)
+{
+    cumulative.reserve(size);
+    double sum = 0.0;
+    for (int rank = 0; rank < size; rank++)
+    {
+        sum += 1.0 / pow(rank + 1.0, exponent);
+        cumulative.push_back(sum);
+    }
+}
+
+string MakeSyntheticWord(int rank)
+{
+    string word;
+    do
+    {
+        word.push_back(static_cast<char>('a' + rank % 26));
+        rank /= 26;
+    } while (rank > 0);
+    return word;
+} // Base 26, so frequent words are short, just like in real text
+
+vector<SyntheticDocument> GenerateCorpus(const CorpusOptions& options)
+{
+    mt19937_64 generator(options.seed);
+    const ZipfDistribution words(options.vocabulary_size, options.zipf_exponent);
+    uniform_int_distribution<int> length(options.min_document_length, options.max_document_length);
+    uniform_int_distribution<int> rating(-10, 10);
+    uniform_int_distribution<int> rating_count(1, 5);
+    uniform_real_distribution<double> chance(0.0, 1.0);
+    const vector<string_view> stop_words = SplitIntoWords(BENCHMARK_STOP_WORDS);
+
+    vector<SyntheticDocument> corpus;
+    corpus.reserve(options.document_count);
+    for (int id = 0; id < options.document_count; id++)
+    {
+        SyntheticDocument document;
+        document.id = id;
+
+        const double status = chance(generator);
+        if (status < 0.85)
+            document.status = DocumentStatus::ACTUAL;
+        else if (status < 0.93)
+            document.status = DocumentStatus::IRRELEVANT;
+        else if (status < 0.98)
+            document.status = DocumentStatus::BANNED;
+        else
+            document.status = DocumentStatus::REMOVED;
+
+        for (int i = rating_count(generator); i > 0; i--)
+        {
+            document.ratings.push_back(rating(generator));
+        }
+
+        if (!corpus.empty() && chance(generator) < options.duplicate_share)
+        {
+            document.text = corpus[uniform_int_distribution<size_t>(0, corpus.size() - 1)(generator)].text;
+            corpus.push_back(move(document));
+            continue;
+        } // Same text, so RemoveDuplicates has something to find
+
+        for (int i = length(generator); i > 0; i--)
+        {
+            if (!document.text.empty())
+                document.text.push_back(' ');
+            if (chance(generator) < 0.1)
+                document.text += stop_words[uniform_int_distribution<size_t>(0, stop_words.size() - 1)(generator)];
+            else
+                document.text += MakeSyntheticWord(words(generator));
+        }
+        corpus.push_back(move(document));
+    }
+    return corpus;
+}
+vector<string> GenerateQueries(const CorpusOptions& corpus_options, const QueryOptions& options)
+{
+    mt19937_64 generator(options.seed);
+    const int head_size = min(HEAD_WORD_COUNT, corpus_options.vocabulary_size);
+    uniform_int_distribution<int> head(0, head_size - 1);
+    uniform_int_distribution<int> tail(min(head_size, corpus_options.vocabulary_size - 1), corpus_options.vocabulary_size - 1);
+    uniform_real_distribution<double> chance(0.0, 1.0);
+
+    const auto next_word = [&]()
+    {
+        return MakeSyntheticWord(chance(generator) < options.head_share ? head(generator) : tail(generator));
+    };
+
+    vector<string> queries;
+    queries.reserve(options.query_count);
+    for (int i = 0; i < options.query_count; i++)
+    {
+        string query;
+        for (int word = 0; word < options.plus_word_count; word++)
+        {
+            query += next_word() + ' ';
+        }
+        for (int word = 0; word < options.minus_word_count; word++)
+        {
+            query += '-' + next_word() + ' ';
+        }
+        query.pop_back();
+        queries.push_back(move(query));
+    }
+    return queries;
+}
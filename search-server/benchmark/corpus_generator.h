@@ -0,0 +1,61 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "document.h"
+
+struct CorpusOptions
+{
+    int document_count = 10000;
+    int min_document_length = 10; // words
+    int max_document_length = 60; // words
+    int vocabulary_size = 50000;
+    double zipf_exponent = 1.0; // 1.0 is close to natural language
+    double duplicate_share = 0.01; // Share of documents, that repeat the words of an earlier document
+    uint64_t seed = 42;
+};
+struct QueryOptions
+{
+    int query_count = 1000;
+    int plus_word_count = 3;
+    int minus_word_count = 1;
+    double head_share = 0.5; // Share of query words, taken from the most frequent HEAD_WORD_COUNT words
+    uint64_t seed = 4242;
+};
+
+struct SyntheticDocument
+{
+    int id = 0;
+    std::string text;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+};
+
+const int HEAD_WORD_COUNT = 100;
+const std::string BENCHMARK_STOP_WORDS = "and in on with";
+
+// Samples ranks 0..size-1 with probability proportional to 1 / (rank + 1)^exponent
+class ZipfDistribution
+{
+public:
+    ZipfDistribution(int size, double exponent);
+
+    template <typename Generator>
+    int operator()(Generator& generator) const
+    {
+        const double point = std::uniform_real_distribution<double>(0.0, cumulative.back())(generator);
+        return static_cast<int>(std::lower_bound(cumulative.begin(), cumulative.end(), point) - cumulative.begin());
+    }
+
+private:
+    std::vector<double> cumulative;
+};
+
+std::string MakeSyntheticWord(int rank); // Distinct, readable word for every rank
+
+std::vector<SyntheticDocument> GenerateCorpus(const CorpusOptions& options);
+std::vector<std::string> GenerateQueries(const CorpusOptions& corpus_options, const QueryOptions& options);
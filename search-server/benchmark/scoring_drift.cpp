@@ -0,0 +1,224 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "corpus_generator.h"
+#include "search_server.h"
+
+using namespace std;
+
+// Usage: search_server_scoring_drift [--documents N] [--vocabulary N] [--zipf X] [--queries N] [--plus-words N] [--minus-words N]
+//                                    [--seed N] [--output FILE]
+// Runs the same queries through the double and the quantized scoring and reports, how far the rankings drift apart.
+// Relevance of every returned document is recomputed from the corpus, so the drift is measured against exact TF-IDF.
+// Exits with failure, if quantized relevance leaves the error bound of QuantizedScale.
+
+struct DriftOptions
+{
+    CorpusOptions corpus;
+    QueryOptions queries;
+    string output;
+};
+struct DriftReport
+{
+    size_t queries = 0;
+    size_t identical_rankings = 0; // Same ids in the same order
+    double overlap_sum = 0.0; // Share of the double top K, that quantized top K has too
+    double max_relevance_error = 0.0; // |quantized relevance - exact relevance| of a returned document
+    double max_error_bound = 0.0;
+    double max_rank_gap = 0.0; // Exact relevance, lost at some rank by taking the quantized document instead of the double one
+    size_t bound_violations = 0;
+};
+
+// Exact TF-IDF of the corpus, computed the same way as SearchServer does, but without any index
+class ReferenceScorer
+{
+public:
+    explicit ReferenceScorer(const vector<SyntheticDocument>& corpus)
+    {
+        const vector<string_view> stop_word_list = SplitIntoWords(BENCHMARK_STOP_WORDS);
+        const set<string_view> stop_words(stop_word_list.begin(), stop_word_list.end());
+        for (const SyntheticDocument& document : corpus)
+        {
+            vector<string_view> words;
+            for (string_view word : SplitIntoWords(document.text))
+            {
+                if (!word.empty() && stop_words.count(word) == 0)
+                    words.push_back(word);
+            }
+            map<string, double>& frequencies = term_frequencies[document.id];
+            for (string_view word : words)
+            {
+                frequencies[string(word)] += 1.0 / words.size();
+            }
+            for (const auto& [word, frequency] : frequencies)
+            {
+                document_counts[word]++;
+            }
+        }
+    }
+
+    vector<double> GetIdfs(const vector<string>& plus_words) const
+    {
+        vector<double> idfs;
+        for (const string& word : plus_words)
+        {
+            const auto count = document_counts.find(word);
+            if (count != document_counts.end())
+                idfs.push_back(log(static_cast<double>(term_frequencies.size()) / count->second));
+        }
+        return idfs;
+    } // Same words, that SearchServer keeps in the query: the ones, that some document has
+    double GetRelevance(int document_id, const vector<string>& plus_words) const
+    {
+        const map<string, double>& frequencies = term_frequencies.at(document_id);
+        double relevance = 0.0;
+        for (const string& word : plus_words)
+        {
+            const auto frequency = frequencies.find(word);
+            if (frequency != frequencies.end())
+                relevance += frequency->second * log(static_cast<double>(term_frequencies.size()) / document_counts.at(word));
+        }
+        return relevance;
+    }
+
+private:
+    map<int, map<string, double>> term_frequencies;
+    map<string, int> document_counts;
+};
+
+vector<string> GetPlusWords(const string& query)
+{
+    set<string> plus_words;
+    for (string_view word : SplitIntoWords(query))
+    {
+        if (!word.empty() && word[0] != '-')
+            plus_words.insert(string(word));
+    }
+    return vector<string>(plus_words.begin(), plus_words.end());
+}
+
+DriftReport MeasureDrift(const vector<SyntheticDocument>& corpus, const vector<string>& queries)
+{
+    SearchServer search_server(BENCHMARK_STOP_WORDS);
+    for (const SyntheticDocument& document : corpus)
+    {
+        search_server.AddDocument(document.id, document.text, document.status, document.ratings);
+    }
+    const ReferenceScorer reference(corpus);
+
+    DriftReport report;
+    for (const string& query : queries)
+    {
+        const vector<Document> exact = search_server.FindTopDocuments(query);
+        const vector<Document> quantized = search_server.FindTopDocuments(quantized_policy, query);
+        const vector<string> plus_words = GetPlusWords(query);
+        const double error_bound = QuantizedScale(reference.GetIdfs(plus_words)).GetErrorBound();
+        report.queries++;
+        report.max_error_bound = max(report.max_error_bound, error_bound);
+
+        bool identical = exact.size() == quantized.size();
+        size_t common = 0;
+        for (size_t rank = 0; rank < quantized.size(); rank++)
+        {
+            const double relevance = reference.GetRelevance(quantized[rank].id, plus_words);
+            const double error = abs(quantized[rank].relevance - relevance);
+            report.max_relevance_error = max(report.max_relevance_error, error);
+            if (error > error_bound)
+                report.bound_violations++;
+
+            identical = identical && exact[rank].id == quantized[rank].id;
+            common += any_of(exact.begin(), exact.end(), [&](const Document& document) { return document.id == quantized[rank].id; });
+            if (rank < exact.size())
+            {
+                // Quantized order may only swap documents, whose exact relevance is within both errors (and EPSILON of the double order)
+                const double gap = reference.GetRelevance(exact[rank].id, plus_words) - relevance;
+                report.max_rank_gap = max(report.max_rank_gap, gap);
+                if (gap > 2 * error_bound + EPSILON)
+                    report.bound_violations++;
+            }
+        }
+        report.identical_rankings += identical;
+        report.overlap_sum += exact.empty() ? 1.0 : static_cast<double>(common) / exact.size();
+    }
+    return report;
+}
+
+void PrintJson(ostream& out, const DriftOptions& options, const DriftReport& report)
+{
+    out << "{\n";
+    out << "  \"options\": { \"documents\": " << options.corpus.document_count << ", \"vocabulary\": " << options.corpus.vocabulary_size
+        << ", \"zipf\": " << options.corpus.zipf_exponent << ", \"queries\": " << options.queries.query_count
+        << ", \"plus_words\": " << options.queries.plus_word_count << ", \"minus_words\": " << options.queries.minus_word_count
+        << ", \"seed\": " << options.corpus.seed << " },\n";
+    out << "  \"avx2_kernel\": " << (IsAvx2KernelEnabled() ? "true" : "false") << ",\n";
+    out << "  \"queries\": " << report.queries << ",\n";
+    out << "  \"identical_rankings\": " << report.identical_rankings << ",\n";
+    out << "  \"mean_top_k_overlap\": " << (report.queries > 0 ? report.overlap_sum / report.queries : 1.0) << ",\n";
+    out << "  \"max_relevance_error\": " << report.max_relevance_error << ",\n";
+    out << "  \"max_error_bound\": " << report.max_error_bound << ",\n";
+    out << "  \"max_rank_gap\": " << report.max_rank_gap << ",\n";
+    out << "  \"bound_violations\": " << report.bound_violations << "\n";
+    out << "}\n";
+}
+
+DriftOptions ParseOptions(int argc, char* argv[])
+{
+    DriftOptions options;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        const string name = argv[i];
+        const string value = argv[i + 1];
+        if (name == "--documents")
+            options.corpus.document_count = stoi(value);
+        else if (name == "--vocabulary")
+            options.corpus.vocabulary_size = stoi(value);
+        else if (name == "--zipf")
+            options.corpus.zipf_exponent = stod(value);
+        else if (name == "--queries")
+            options.queries.query_count = stoi(value);
+        else if (name == "--plus-words")
+            options.queries.plus_word_count = stoi(value);
+        else if (name == "--minus-words")
+            options.queries.minus_word_count = stoi(value);
+        else if (name == "--seed")
+        {
+            options.corpus.seed = stoull(value);
+            options.queries.seed = options.corpus.seed + 1;
+        }
+        else if (name == "--output")
+            options.output = value;
+        else
+            throw invalid_argument("Unknown option: " + name);
+    }
+    return options;
+}
+
+int main(int argc, char* argv[])
+{
+    try
+    {
+        const DriftOptions options = ParseOptions(argc, argv);
+        const DriftReport report = MeasureDrift(GenerateCorpus(options.corpus), GenerateQueries(options.corpus, options.queries));
+
+        if (options.output.empty())
+            PrintJson(cout, options, report);
+        else
+        {
+            ofstream out(options.output);
+            PrintJson(out, options, report);
+        }
+        return report.bound_violations == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    catch (const exception& e)
+    {
+        cerr << "Scoring drift failed: " << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+}
@@ -1,30 +1,47 @@
-#pragma once
-
-#include <string>
-#include <map>
-#include <iostream>
-
-// There are only 2 functions, so addition of .cpp for them seems unnecessary
-struct Document
-{
-    int id = 0;
-    double relevance = 0.0;
-    int rating = 0;
-    Document() = default;
-    Document(int id_, double relevance_, int rating_)
-    {
-        id = id_;
-        relevance = relevance_;
-        rating = rating_;
-    }
-};
-enum class DocumentStatus
-{
-    ACTUAL,
-    IRRELEVANT,
-    BANNED,
-    REMOVED
-};
-
-void PrintDocument(const Document& document);
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <map>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+// There are only 2 functions, so addition of .cpp for them seems unnecessary
+struct Document
+{
+    int id = 0;
+    double relevance = 0.0;
+    int rating = 0;
+    Document() = default;
+    Document(int id_, double relevance_, int rating_)
+    {
+        id = id_;
+        relevance = relevance_;
+        rating = rating_;
+    }
+};
+// Top documents of a search, that may be cut short by its deadline (see SearchServer::FindTopDocumentsAsync)
+struct TopDocumentsResult
+{
+    std::vector<Document> documents;
+    bool truncated = false; // Search was stopped early: documents are the best of the postings visited until then
+};
+// Top document with the part of its text, that matches the query best (see SearchServer::FindTopDocumentsWithSnippets)
+struct DocumentSnippet
+{
+    Document document;
+    std::string_view text; // Window of the stored text of the document
+    std::vector<std::pair<size_t, size_t>> highlights; // [begin, end) of every query word, relative to text
+};
+enum class DocumentStatus
+{
+    ACTUAL,
+    IRRELEVANT,
+    BANNED,
+    REMOVED
+};
+const size_t DOCUMENT_STATUS_COUNT = 4;
+
+void PrintDocument(const Document& document);
 std::ostream& operator<< (std::ostream& out, const Document& document);
\ No newline at end of file
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+
+#include "document.h"
+#include "roaring_bitmap.h"
+
+// Declarative document filter. Unlike a predicate lambda, it can be checked against a whole posting partition at once,
+// so SearchServer skips partitions of rejected statuses and ratings without visiting their postings.
+// Id allow-lists and deny-lists are matched against postings block by block (see RoaringBitmap)
+struct DocumentFilter
+{
+    uint32_t statuses = (1u << DOCUMENT_STATUS_COUNT) - 1; // Bit per DocumentStatus
+    int min_rating = std::numeric_limits<int>::min(); // inclusive
+    int max_rating = std::numeric_limits<int>::max(); // inclusive
+    std::shared_ptr<const RoaringBitmap> allowed_ids; // nullptr allows every id
+    std::shared_ptr<const RoaringBitmap> denied_ids; // nullptr denies none
+
+    static DocumentFilter ForStatus(DocumentStatus status)
+    {
+        DocumentFilter filter;
+        filter.statuses = StatusBit(status);
+        return filter;
+    }
+    DocumentFilter& AddStatus(DocumentStatus status)
+    {
+        statuses |= StatusBit(status);
+        return *this;
+    }
+    DocumentFilter& WithRating(int min, int max)
+    {
+        min_rating = min;
+        max_rating = max;
+        return *this;
+    }
+    DocumentFilter& AllowIds(std::shared_ptr<const RoaringBitmap> ids)
+    {
+        allowed_ids = std::move(ids);
+        return *this;
+    } // Use operator& to allow the intersection of several lists
+    DocumentFilter& DenyIds(std::shared_ptr<const RoaringBitmap> ids)
+    {
+        denied_ids = std::move(ids);
+        return *this;
+    } // Use operator| to deny the union of several lists
+
+    bool AcceptsStatus(DocumentStatus status) const
+    {
+        return (statuses & StatusBit(status)) != 0;
+    }
+    bool AcceptsRating(int rating) const
+    {
+        return rating >= min_rating && rating <= max_rating;
+    }
+    bool AcceptsAnyRating(int min, int max) const
+    {
+        return min <= max_rating && max >= min_rating;
+    } // Some of the ratings in [min, max] may pass
+    bool AcceptsAllRatings(int min, int max) const
+    {
+        return min >= min_rating && max <= max_rating;
+    } // Every rating in [min, max] passes, so there is no need to check them one by one
+    bool HasIdSets() const
+    {
+        return allowed_ids != nullptr || denied_ids != nullptr;
+    }
+    bool AcceptsId(int document_id) const
+    {
+        const uint32_t id = static_cast<uint32_t>(document_id);
+        return (allowed_ids == nullptr || allowed_ids->Contains(id)) && (denied_ids == nullptr || !denied_ids->Contains(id));
+    } // One document at a time; postings are checked block by block instead
+
+private:
+    static uint32_t StatusBit(DocumentStatus status)
+    {
+        return 1u << static_cast<uint32_t>(status);
+    }
+};
+
+// Predicate, that accepts everything. FindAllDocuments recognizes it and skips per posting checks entirely
+struct AcceptAllDocuments
+{
+    bool operator()(int /*document_id*/, DocumentStatus /*status*/, int /*rating*/) const
+    {
+        return true;
+    }
+};
@@ -0,0 +1,254 @@
+#include "index_segment.h"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace
+{
+    bool IsLowerId(const Posting& lhs, const Posting& rhs)
+    {
+        return lhs.document_id < rhs.document_id;
+    }
+
+    // Appends postings, that are not deleted, and returns whether any of them survived
+    bool AppendLivePostings(span<const Posting> source, const RoaringBitmap& deleted_ids, int word_id, vector<Posting>& destination, PurgedPostings& purged)
+    {
+        const size_t initial_size = destination.size();
+        if (deleted_ids.IsEmpty())
+            destination.insert(destination.end(), source.begin(), source.end());
+        else
+        {
+            for (const Posting& posting : source)
+            {
+                if (deleted_ids.Contains(static_cast<uint32_t>(posting.document_id)))
+                    purged[word_id]++;
+                else
+                    destination.push_back(posting);
+            }
+        }
+        return destination.size() > initial_size;
+    }
+
+    MemoryUsage EstimateBitmapUsage(const RoaringBitmap& bitmap)
+    {
+        return { bitmap.GetMemoryUsage(), 0 }; // Allocations of the bitmap are not exposed, they are few compared to the postings anyway
+    }
+    template <typename T>
+    MemoryUsage EstimateVectorUsage(const vector<T>& values)
+    {
+        return { values.capacity() * sizeof(T), values.capacity() > 0 ? size_t(1) : size_t(0) };
+    }
+}
+
+const Posting* FindPosting(span<const Posting> postings, int document_id)
+{
+    const auto posting = lower_bound(postings.begin(), postings.end(), Posting{ document_id, 0.0f, 0 }, IsLowerId);
+    return posting != postings.end() && posting->document_id == document_id ? &*posting : nullptr;
+}
+
+SegmentBuffer::BufferedWord::BufferedWord()
+{
+    min_ratings.fill(numeric_limits<int>::max());
+    max_ratings.fill(numeric_limits<int>::min());
+}
+void SegmentBuffer::AddDocument(int document_id, DocumentStatus status, int rating, const vector<pair<int, double>>& word_frequencies)
+{
+    const size_t partition = static_cast<size_t>(status);
+    for (const auto& [word_id, term_frequency] : word_frequencies)
+    {
+        BufferedWord& word = words[word_id];
+        vector<Posting>& postings = word.postings[partition];
+        const Posting posting = { document_id, static_cast<float>(term_frequency), rating };
+        if (postings.empty() || postings.back().document_id < document_id)
+            postings.push_back(posting); // Ids usually grow, so it is an append
+        else
+            postings.insert(lower_bound(postings.begin(), postings.end(), posting, IsLowerId), posting);
+        word.min_ratings[partition] = min(word.min_ratings[partition], rating);
+        word.max_ratings[partition] = max(word.max_ratings[partition], rating);
+    }
+    document_ids.Add(static_cast<uint32_t>(document_id));
+}
+void SegmentBuffer::RemoveDocument(int document_id, DocumentStatus status, span<const DocumentWord> document_words, PurgedPostings& purged)
+{
+    const size_t partition = static_cast<size_t>(status);
+    for (const auto& [word_id, term_frequency] : document_words)
+    {
+        const auto word = words.find(word_id);
+        vector<Posting>& postings = word->second.postings[partition];
+        postings.erase(lower_bound(postings.begin(), postings.end(), Posting{ document_id, 0.0f, 0 }, IsLowerId));
+        purged[word_id]++;
+        if (all_of(word->second.postings.begin(), word->second.postings.end(), [](const vector<Posting>& postings) { return postings.empty(); }))
+            words.erase(word);
+    }
+    document_ids.Remove(static_cast<uint32_t>(document_id));
+} // Rating bounds are left wide, the same as in sealed segments
+vector<DocumentWord> SegmentBuffer::FindDocumentWords(int document_id, DocumentStatus status) const
+{
+    vector<DocumentWord> result;
+    for (const auto& [word_id, word] : words)
+    {
+        const Posting* posting = FindPosting(word.postings[static_cast<size_t>(status)], document_id);
+        if (posting != nullptr)
+            result.push_back({ word_id, posting->term_frequency });
+    }
+    return result;
+}
+MemoryUsage SegmentBuffer::GetMemoryUsage() const
+{
+    const size_t NODE_OVERHEAD = 4 * sizeof(void*); // Color and links of the tree node
+    MemoryUsage usage = EstimateBitmapUsage(document_ids);
+    for (const auto& [word_id, word] : words)
+    {
+        usage += { sizeof(pair<const int, BufferedWord>) + NODE_OVERHEAD, 1 };
+        for (const vector<Posting>& postings : word.postings)
+        {
+            usage += EstimateVectorUsage(postings);
+        }
+    }
+    return usage;
+}
+WordPartitions SegmentBuffer::FindWord(int word_id) const
+{
+    WordPartitions partitions;
+    const auto word = words.find(word_id);
+    if (word == words.end())
+        return partitions;
+
+    for (size_t status = 0; status < DOCUMENT_STATUS_COUNT; status++)
+    {
+        partitions[status] = { word->second.postings[status], word->second.min_ratings[status], word->second.max_ratings[status], {}, {} };
+    }
+    return partitions;
+}
+
+SealedSegment::SealedSegment(const SegmentBuffer& buffer) : document_ids(buffer.document_ids)
+{
+    words.reserve(buffer.words.size());
+    for (const auto& [word_id, buffered] : buffer.words)
+    {
+        SegmentWord word = { word_id, {}, buffered.min_ratings, buffered.max_ratings };
+        for (size_t status = 0; status < DOCUMENT_STATUS_COUNT; status++)
+        {
+            word.offsets[status] = static_cast<uint32_t>(postings.size());
+            postings.insert(postings.end(), buffered.postings[status].begin(), buffered.postings[status].end());
+        }
+        word.offsets[DOCUMENT_STATUS_COUNT] = static_cast<uint32_t>(postings.size());
+        AppendWord(word);
+    }
+    postings.shrink_to_fit();
+    BuildQuantizedPostings();
+}
+SealedSegment SealedSegment::Merge(const vector<shared_ptr<const SealedSegment>>& segments, const vector<RoaringBitmap>& deleted_ids, PurgedPostings& purged)
+{
+    SealedSegment result;
+    size_t posting_count = 0;
+    for (size_t i = 0; i < segments.size(); i++)
+    {
+        posting_count += segments[i]->postings.size();
+        result.document_ids = result.document_ids | AndNot(segments[i]->document_ids, deleted_ids[i]);
+    }
+    result.postings.reserve(posting_count);
+
+    // Word tables are sorted by word id, so they are merged the same way as sorted lists
+    vector<size_t> positions(segments.size(), 0);
+    while (true)
+    {
+        int word_id = numeric_limits<int>::max();
+        for (size_t i = 0; i < segments.size(); i++)
+        {
+            if (positions[i] < segments[i]->words.size())
+                word_id = min(word_id, segments[i]->words[positions[i]].word_id);
+        }
+        if (word_id == numeric_limits<int>::max())
+            break;
+
+        SegmentWord word = { word_id, {}, {}, {} };
+        for (size_t status = 0; status < DOCUMENT_STATUS_COUNT; status++)
+        {
+            const size_t partition_begin = result.postings.size();
+            word.offsets[status] = static_cast<uint32_t>(partition_begin);
+            word.min_ratings[status] = numeric_limits<int>::max();
+            word.max_ratings[status] = numeric_limits<int>::min();
+            for (size_t i = 0; i < segments.size(); i++)
+            {
+                if (positions[i] == segments[i]->words.size() || segments[i]->words[positions[i]].word_id != word_id)
+                    continue;
+
+                const SegmentWord& source = segments[i]->words[positions[i]];
+                const size_t run_begin = result.postings.size();
+                const span<const Posting> source_postings(segments[i]->postings.data() + source.offsets[status], source.offsets[status + 1] - source.offsets[status]);
+                if (!AppendLivePostings(source_postings, deleted_ids[i], word_id, result.postings, purged))
+                    continue;
+
+                // Every run is sorted by id already, ids of different segments are interleaved
+                inplace_merge(result.postings.begin() + partition_begin, result.postings.begin() + run_begin, result.postings.end(), IsLowerId);
+                word.min_ratings[status] = min(word.min_ratings[status], source.min_ratings[status]);
+                word.max_ratings[status] = max(word.max_ratings[status], source.max_ratings[status]);
+            }
+        }
+        word.offsets[DOCUMENT_STATUS_COUNT] = static_cast<uint32_t>(result.postings.size());
+        result.AppendWord(word);
+
+        for (size_t i = 0; i < segments.size(); i++)
+        {
+            if (positions[i] < segments[i]->words.size() && segments[i]->words[positions[i]].word_id == word_id)
+                positions[i]++;
+        }
+    }
+    result.postings.shrink_to_fit();
+    result.BuildQuantizedPostings();
+    return result;
+}
+
+WordPartitions SealedSegment::FindWord(int word_id) const
+{
+    WordPartitions partitions;
+    const auto word = lower_bound(words.begin(), words.end(), word_id, [](const SegmentWord& word, int id) { return word.word_id < id; });
+    if (word == words.end() || word->word_id != word_id)
+        return partitions;
+
+    for (size_t status = 0; status < DOCUMENT_STATUS_COUNT; status++)
+    {
+        const size_t begin = word->offsets[status];
+        const size_t size = word->offsets[status + 1] - begin;
+        partitions[status] = { span<const Posting>(postings.data() + begin, size), word->min_ratings[status], word->max_ratings[status],
+            span<const uint32_t>(posting_ordinals.data() + begin, size), span<const uint16_t>(quantized_tfs.data() + begin, size) };
+    }
+    return partitions;
+}
+void SealedSegment::AppendWord(const SegmentWord& word)
+{
+    if (word.offsets[0] != word.offsets[DOCUMENT_STATUS_COUNT])
+        words.push_back(word);
+}
+vector<DocumentWord> SealedSegment::FindDocumentWords(int document_id, DocumentStatus status) const
+{
+    vector<DocumentWord> result;
+    const size_t partition = static_cast<size_t>(status);
+    for (const SegmentWord& word : words)
+    {
+        const span<const Posting> partition_postings(postings.data() + word.offsets[partition], word.offsets[partition + 1] - word.offsets[partition]);
+        const Posting* posting = FindPosting(partition_postings, document_id);
+        if (posting != nullptr)
+            result.push_back({ word.word_id, posting->term_frequency });
+    }
+    return result;
+}
+MemoryUsage SealedSegment::GetMemoryUsage() const
+{
+    return EstimateVectorUsage(words) + EstimateVectorUsage(postings) + EstimateBitmapUsage(document_ids)
+        + EstimateVectorUsage(ordinal_ids) + EstimateVectorUsage(posting_ordinals) + EstimateVectorUsage(quantized_tfs);
+}
+void SealedSegment::BuildQuantizedPostings()
+{
+    ordinal_ids = document_ids.ToVector();
+    posting_ordinals.reserve(postings.size());
+    quantized_tfs.reserve(postings.size());
+    for (const Posting& posting : postings)
+    {
+        const auto ordinal = lower_bound(ordinal_ids.begin(), ordinal_ids.end(), static_cast<uint32_t>(posting.document_id));
+        posting_ordinals.push_back(static_cast<uint32_t>(ordinal - ordinal_ids.begin()));
+        quantized_tfs.push_back(QuantizeTermFrequency(posting.term_frequency));
+    }
+}
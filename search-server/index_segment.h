@@ -0,0 +1,171 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <memory>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "document.h"
+#include "memory_tracking.h"
+#include "quantized_scoring.h"
+#include "roaring_bitmap.h"
+
+// Term frequency is float, so a posting takes 12 bytes without padding. Relevance is still summed up in double.
+// Rating of the document is kept next to it, so rating filters and predicates don't look the document up for every posting
+struct Posting
+{
+    int document_id;
+    float term_frequency;
+    int rating;
+};
+
+// View of the postings of one word and one document status inside a segment, sorted by document id
+struct PostingPartition
+{
+    std::span<const Posting> postings;
+    int min_rating = std::numeric_limits<int>::max();
+    int max_rating = std::numeric_limits<int>::min();
+    // Same postings for QuantizedPolicy: ordinals of the documents in the segment and quantized TF. Empty for the buffer
+    std::span<const uint32_t> ordinals;
+    std::span<const uint16_t> quantized_tfs;
+}; // Rating bounds only widen, until the segment is rewritten, so they are safe to prune by
+using WordPartitions = std::array<PostingPartition, DOCUMENT_STATUS_COUNT>; // [DocumentStatus]
+
+// Entry of the forward index, with the same float frequency as the posting
+struct DocumentWord
+{
+    int word_id;
+    float term_frequency;
+};
+
+const Posting* FindPosting(std::span<const Posting> postings, int document_id); // postings have to be sorted by document id; nullptr, if there is none
+
+// Postings, that were dropped while sealing or merging segments, by word id.
+// SearchServer releases words, once none of the segments refers to them
+using PurgedPostings = std::map<int, size_t>;
+
+// Small mutable segment, where new documents are indexed. It is sealed into SealedSegment, once it is full
+class SegmentBuffer
+{
+public:
+    void AddDocument(int document_id, DocumentStatus status, int rating, const std::vector<std::pair<int, double>>& word_frequencies); // [word id, term frequency]
+    void RemoveDocument(int document_id, DocumentStatus status, std::span<const DocumentWord> words, PurgedPostings& purged); // Buffer is mutable, so postings are erased right away
+
+    WordPartitions FindWord(int word_id) const; // Empty partitions, if no document of the segment has the word
+    std::vector<DocumentWord> FindDocumentWords(int document_id, DocumentStatus status) const; // Sorted by word id; scans every word of the segment
+    template <typename Action>
+    void ForEachPosting(Action action) const; // Calls action(word id, posting) in the order of word ids
+    bool ContainsDocument(int document_id) const
+    {
+        return document_ids.Contains(static_cast<uint32_t>(document_id));
+    }
+    size_t GetDocumentCount() const
+    {
+        return document_ids.GetCardinality();
+    }
+    std::vector<uint32_t> GetDocumentIds() const
+    {
+        return document_ids.ToVector();
+    } // Sorted, so the index of an id is its ordinal
+    MemoryUsage GetMemoryUsage() const; // Estimated from capacities of the containers
+    bool IsEmpty() const
+    {
+        return document_ids.IsEmpty();
+    }
+
+private:
+    friend class SealedSegment;
+
+    struct BufferedWord
+    {
+        std::array<std::vector<Posting>, DOCUMENT_STATUS_COUNT> postings; // [DocumentStatus], sorted by document id
+        std::array<int, DOCUMENT_STATUS_COUNT> min_ratings;
+        std::array<int, DOCUMENT_STATUS_COUNT> max_ratings;
+
+        BufferedWord();
+    };
+    std::map<int, BufferedWord> words; // [word id]
+    RoaringBitmap document_ids;
+};
+
+// Immutable read optimized segment: postings of all words are stored in one contiguous array,
+// grouped by word id and then by document status. Queries find a word by binary search over the word table
+class SealedSegment
+{
+public:
+    explicit SealedSegment(const SegmentBuffer& buffer);
+    // Drops postings of deleted_ids[i] from segments[i] and counts them in purged
+    static SealedSegment Merge(const std::vector<std::shared_ptr<const SealedSegment>>& segments, const std::vector<RoaringBitmap>& deleted_ids, PurgedPostings& purged);
+
+    WordPartitions FindWord(int word_id) const; // Empty partitions, if no document of the segment has the word
+    std::vector<DocumentWord> FindDocumentWords(int document_id, DocumentStatus status) const; // Sorted by word id; scans every word of the segment
+    template <typename Action>
+    void ForEachPosting(Action action) const; // Calls action(word id, posting) in the order of word ids
+    bool ContainsDocument(int document_id) const
+    {
+        return document_ids.Contains(static_cast<uint32_t>(document_id));
+    }
+    size_t GetDocumentCount() const
+    {
+        return document_ids.GetCardinality();
+    }
+    size_t GetPostingCount() const
+    {
+        return postings.size();
+    }
+    std::span<const uint32_t> GetDocumentIds() const
+    {
+        return ordinal_ids;
+    } // Sorted, so the index of an id is its ordinal, including removed documents
+    MemoryUsage GetMemoryUsage() const; // Estimated from capacities of the containers
+
+private:
+    struct SegmentWord
+    {
+        int word_id;
+        std::array<uint32_t, DOCUMENT_STATUS_COUNT + 1> offsets; // Partition of status s is postings[offsets[s], offsets[s + 1])
+        std::array<int, DOCUMENT_STATUS_COUNT> min_ratings;
+        std::array<int, DOCUMENT_STATUS_COUNT> max_ratings;
+    };
+    std::vector<SegmentWord> words; // Sorted by word id
+    std::vector<Posting> postings;
+    RoaringBitmap document_ids; // Documents, indexed into the segment
+    std::vector<uint32_t> ordinal_ids; // [ordinal] -> document id
+    std::vector<uint32_t> posting_ordinals; // Parallel to postings
+    std::vector<uint16_t> quantized_tfs; // Parallel to postings
+
+    SealedSegment() = default;
+    void AppendWord(const SegmentWord& word); // Closes the word, whose postings were just appended, dropping it if it has none
+    void BuildQuantizedPostings(); // Called last by both constructors, once postings are final
+};
+
+template <typename Action>
+void SegmentBuffer::ForEachPosting(Action action) const
+{
+    for (const auto& [word_id, word] : words)
+    {
+        for (const std::vector<Posting>& postings : word.postings)
+        {
+            for (const Posting& posting : postings)
+            {
+                action(word_id, posting);
+            }
+        }
+    }
+}
+template <typename Action>
+void SealedSegment::ForEachPosting(Action action) const
+{
+    for (const SegmentWord& word : words)
+    {
+        for (uint32_t offset = word.offsets[0]; offset < word.offsets[DOCUMENT_STATUS_COUNT]; offset++)
+        {
+            action(word.word_id, postings[offset]);
+        }
+    }
+}
@@ -0,0 +1,44 @@
+#include "levenshtein_automaton.h"
+
+#include <algorithm>
+
+using namespace std;
+
+LevenshteinAutomaton::LevenshteinAutomaton(string_view word, int max_edits) : word(word), max_edits(max_edits), row_size(word.size() + 1)
+{
+    // Input longer than the word by more than max_edits is never accepted, so the rows are allocated once for the deepest possible walk
+    const size_t max_depth = word.size() + max_edits;
+    rows.resize((max_depth + 1) * row_size);
+    input.resize(max_depth);
+    for (size_t length = 0; length < row_size; length++)
+    {
+        rows[length] = static_cast<uint8_t>(min<size_t>(length, max_edits + 1));
+    }
+}
+
+bool LevenshteinAutomaton::Step(size_t depth, char label)
+{
+    if (depth >= input.size())
+        return false;
+    input[depth] = label;
+
+    const uint8_t dead = static_cast<uint8_t>(max_edits + 1);
+    const uint8_t* previous = rows.data() + depth * row_size;
+    uint8_t* row = rows.data() + (depth + 1) * row_size;
+    row[0] = static_cast<uint8_t>(min<size_t>(depth + 1, dead));
+    uint8_t best = row[0];
+    for (size_t length = 1; length < row_size; length++)
+    {
+        const uint8_t substitution = previous[length - 1] + (word[length - 1] == label ? 0 : 1);
+        uint8_t distance = min({ static_cast<uint8_t>(previous[length] + 1), static_cast<uint8_t>(row[length - 1] + 1), substitution });
+        if (depth > 0 && length > 1 && word[length - 2] == label && word[length - 1] == input[depth - 1])
+            distance = min(distance, static_cast<uint8_t>(rows[(depth - 1) * row_size + length - 2] + 1)); // Transposition
+        row[length] = min(distance, dead);
+        best = min(best, row[length]);
+    }
+    return best < dead;
+}
+int LevenshteinAutomaton::GetDistance(size_t depth) const
+{
+    return rows[depth * row_size + row_size - 1];
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Accepts the words within max_edits edits of one word: insertions, deletions, substitutions and transpositions of two
+// neighbouring characters. States are rows of the edit distance matrix, that are computed lazily, one row per character of the input,
+// so the automaton is meant to be walked together with a sorted dictionary (see TermTrie::Intersect): once no cell of the row is
+// within max_edits, no word with this input can be accepted, and the whole branch is skipped
+class LevenshteinAutomaton
+{
+public:
+    LevenshteinAutomaton(std::string_view word, int max_edits);
+
+    bool Step(size_t depth, char label); // Reads label after the first depth characters of the input; false, if the state is dead
+    int GetDistance(size_t depth) const; // Of the first depth characters of the input to the word, capped at max_edits + 1
+
+private:
+    std::string word;
+    int max_edits;
+    size_t row_size;
+    std::vector<uint8_t> rows; // [depth * row_size + length of the word prefix], distances capped at max_edits + 1
+    std::string input; // [depth], characters, that Step has read
+};
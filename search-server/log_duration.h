@@ -1,36 +1,36 @@
-#pragma once
-
-#include <algorithm>
-#include <chrono>
-#include <cstdlib>
-#include <iostream>
-#include <vector>
-#include <chrono>
-
-#define PROFILE_CONCAT_INTERNAL(X, Y) X##Y
-#define PROFILE_CONCAT(X, Y) PROFILE_CONCAT_INTERNAL(X, Y)
-#define UNIQUE_VAR_NAME_PROFILE PROFILE_CONCAT(profileGuard, __LINE__)
-#define LOG_DURATION(x) LogDuration UNIQUE_VAR_NAME_PROFILE(x)
-#define LOG_DURATION_STREAM(x, stream) LogDuration UNIQUE_VAR_NAME_PROFILE(x, stream)
-
-class LogDuration
-{
-public:
-    using Clock = std::chrono::steady_clock;
-
-    LogDuration(const std::string& id, std::ostream& stream = std::cerr) : id_(id), stream_(stream) { }
-
-    ~LogDuration() {
-        using namespace std::chrono;
-        using namespace std::literals;
-
-        const auto end_time = Clock::now();
-        const auto dur = end_time - start_time_;
-        stream_ << id_ << ": "s << duration_cast<milliseconds>(dur).count() << " ms" << std::endl;
-    }
-
-private:
-    const std::string id_;
-    std::ostream& stream_;
-    const Clock::time_point start_time_ = Clock::now();
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include <chrono>
+
+#define PROFILE_CONCAT_INTERNAL(X, Y) X##Y
+#define PROFILE_CONCAT(X, Y) PROFILE_CONCAT_INTERNAL(X, Y)
+#define UNIQUE_VAR_NAME_PROFILE PROFILE_CONCAT(profileGuard, __LINE__)
+#define LOG_DURATION(x) LogDuration UNIQUE_VAR_NAME_PROFILE(x)
+#define LOG_DURATION_STREAM(x, stream) LogDuration UNIQUE_VAR_NAME_PROFILE(x, stream)
+
+class LogDuration
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    LogDuration(const std::string& id, std::ostream& stream = std::cerr) : id_(id), stream_(stream) { }
+
+    ~LogDuration() {
+        using namespace std::chrono;
+        using namespace std::literals;
+
+        const auto end_time = Clock::now();
+        const auto dur = end_time - start_time_;
+        stream_ << id_ << ": "s << duration_cast<milliseconds>(dur).count() << " ms" << std::endl;
+    }
+
+private:
+    const std::string id_;
+    std::ostream& stream_;
+    const Clock::time_point start_time_ = Clock::now();
 };
\ No newline at end of file
@@ -0,0 +1,36 @@
+#include "memory_tracking.h"
+
+using namespace std;
+
+MemoryUsage& MemoryUsage::operator+=(const MemoryUsage& other)
+{
+    bytes += other.bytes;
+    allocations += other.allocations;
+    return *this;
+}
+MemoryUsage operator+(MemoryUsage lhs, const MemoryUsage& rhs)
+{
+    return lhs += rhs;
+}
+
+MemoryUsage TrackingMemoryResource::GetUsage() const
+{
+    return { bytes.load(memory_order_relaxed), allocations.load(memory_order_relaxed) };
+}
+void* TrackingMemoryResource::do_allocate(size_t size, size_t alignment)
+{
+    void* pointer = upstream->allocate(size, alignment);
+    bytes.fetch_add(size, memory_order_relaxed);
+    allocations.fetch_add(1, memory_order_relaxed);
+    return pointer;
+}
+void TrackingMemoryResource::do_deallocate(void* pointer, size_t size, size_t alignment)
+{
+    upstream->deallocate(pointer, size, alignment);
+    bytes.fetch_sub(size, memory_order_relaxed);
+    allocations.fetch_sub(1, memory_order_relaxed);
+}
+bool TrackingMemoryResource::do_is_equal(const pmr::memory_resource& other) const noexcept
+{
+    return this == &other; // Memory has to be given back to the same resource, or it would be counted in the wrong structure
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory_resource>
+
+struct MemoryUsage
+{
+    size_t bytes = 0;
+    size_t allocations = 0; // Blocks, that are currently allocated
+
+    MemoryUsage& operator+=(const MemoryUsage& other);
+};
+MemoryUsage operator+(MemoryUsage lhs, const MemoryUsage& rhs);
+
+// Memory resource, that counts what is allocated through it and passes the requests on to upstream.
+// One resource is given to every structure, that has to be accounted for separately: pmr containers pass it down to
+// their nodes and elements, so a map of strings is counted as a whole. Counters are relaxed atomics, so the resource
+// can be shared between threads
+class TrackingMemoryResource : public std::pmr::memory_resource
+{
+public:
+    explicit TrackingMemoryResource(std::pmr::memory_resource* upstream = std::pmr::new_delete_resource()) : upstream(upstream) {}
+    TrackingMemoryResource(const TrackingMemoryResource&) = delete;
+    TrackingMemoryResource& operator=(const TrackingMemoryResource&) = delete;
+
+    MemoryUsage GetUsage() const;
+
+private:
+    std::pmr::memory_resource* upstream;
+    std::atomic<size_t> bytes = 0;
+    std::atomic<size_t> allocations = 0;
+
+    void* do_allocate(size_t size, size_t alignment) override;
+    void do_deallocate(void* pointer, size_t size, size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+};
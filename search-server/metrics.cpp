@@ -0,0 +1,297 @@
+#include "metrics.h"
+
+#include <bit>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+    struct ThreadShard
+    {
+        array<array<atomic<uint64_t>, HISTOGRAM_BUCKET_COUNT>, TIMER_COUNT> buckets{};
+        array<atomic<uint64_t>, TIMER_COUNT> counts{};
+        array<atomic<uint64_t>, TIMER_COUNT> sums{};
+        array<atomic<uint64_t>, COUNTER_COUNT> counters{};
+    }; // Written only by its own thread, read by snapshots
+
+    void AddRelaxed(atomic<uint64_t>& value, uint64_t addition)
+    {
+        value.store(value.load(memory_order_relaxed) + addition, memory_order_relaxed);
+    } // Shard has a single writer, so there is no need for a locked read-modify-write
+
+    void AddShard(MetricsSnapshot& snapshot, const ThreadShard& shard)
+    {
+        for (size_t timer = 0; timer < TIMER_COUNT; timer++)
+        {
+            HistogramSnapshot& histogram = snapshot.timers[timer];
+            histogram.count += shard.counts[timer].load(memory_order_relaxed);
+            histogram.sum += shard.sums[timer].load(memory_order_relaxed);
+            for (size_t bucket = 0; bucket < HISTOGRAM_BUCKET_COUNT; bucket++)
+            {
+                histogram.buckets[bucket] += shard.buckets[timer][bucket].load(memory_order_relaxed);
+            }
+        }
+        for (size_t counter = 0; counter < COUNTER_COUNT; counter++)
+        {
+            snapshot.counters[counter] += shard.counters[counter].load(memory_order_relaxed);
+        }
+    }
+    void SubtractSnapshot(MetricsSnapshot& snapshot, const MetricsSnapshot& baseline)
+    {
+        for (size_t timer = 0; timer < TIMER_COUNT; timer++)
+        {
+            snapshot.timers[timer].count -= baseline.timers[timer].count;
+            snapshot.timers[timer].sum -= baseline.timers[timer].sum;
+            for (size_t bucket = 0; bucket < HISTOGRAM_BUCKET_COUNT; bucket++)
+            {
+                snapshot.timers[timer].buckets[bucket] -= baseline.timers[timer].buckets[bucket];
+            }
+        }
+        for (size_t counter = 0; counter < COUNTER_COUNT; counter++)
+        {
+            snapshot.counters[counter] -= baseline.counters[counter];
+        }
+    }
+
+    class MetricsRegistry
+    {
+    public:
+        void Register(ThreadShard* shard)
+        {
+            lock_guard guard(registry_mutex);
+            shards.push_back(shard);
+        }
+        void Unregister(ThreadShard* shard)
+        {
+            lock_guard guard(registry_mutex);
+            AddShard(retired, *shard); // Keep what exited thread has recorded
+            erase(shards, shard);
+        }
+        MetricsSnapshot Collect()
+        {
+            lock_guard guard(registry_mutex);
+            MetricsSnapshot snapshot = CollectTotal();
+            SubtractSnapshot(snapshot, baseline);
+            return snapshot;
+        }
+        void Reset()
+        {
+            lock_guard guard(registry_mutex);
+            baseline = CollectTotal();
+        } // Shards are never written by other threads, so reset only moves the baseline
+
+    private:
+        mutex registry_mutex;
+        vector<ThreadShard*> shards;
+        MetricsSnapshot retired;
+        MetricsSnapshot baseline;
+
+        MetricsSnapshot CollectTotal() const
+        {
+            MetricsSnapshot snapshot = retired;
+            for (const ThreadShard* shard : shards)
+            {
+                AddShard(snapshot, *shard);
+            }
+            return snapshot;
+        } // Requires mutex
+    };
+    MetricsRegistry& GetRegistry()
+    {
+        static MetricsRegistry registry;
+        return registry;
+    }
+
+    class ThreadShardHolder
+    {
+    public:
+        ThreadShardHolder()
+        {
+            GetRegistry().Register(shard.get());
+        }
+        ~ThreadShardHolder()
+        {
+            GetRegistry().Unregister(shard.get());
+        }
+        ThreadShard& Get()
+        {
+            return *shard;
+        }
+
+    private:
+        unique_ptr<ThreadShard> shard = make_unique<ThreadShard>();
+    };
+    ThreadShard& GetThreadShard()
+    {
+        thread_local ThreadShardHolder holder;
+        return holder.Get();
+    }
+
+    string FormatSeconds(uint64_t nanoseconds)
+    {
+        const string fraction = to_string(nanoseconds % 1000000000);
+        return to_string(nanoseconds / 1000000000) + '.' + string(9 - fraction.size(), '0') + fraction;
+    } // Exact decimal, so every bucket bound is a distinct label, that stays the same between scrapes
+}
+
+size_t GetHistogramBucket(uint64_t nanoseconds)
+{
+    const uint64_t sub_bucket_count = uint64_t(1) << HISTOGRAM_SUB_BUCKET_BITS;
+    if (nanoseconds < sub_bucket_count)
+        return static_cast<size_t>(nanoseconds);
+
+    const int exponent = bit_width(nanoseconds) - 1;
+    if (exponent > HISTOGRAM_MAX_EXPONENT)
+        return HISTOGRAM_OVERFLOW_BUCKET;
+
+    const int shift = exponent - HISTOGRAM_SUB_BUCKET_BITS;
+    const uint64_t sub_bucket = (nanoseconds >> shift) - sub_bucket_count;
+    return static_cast<size_t>(((shift + 1) << HISTOGRAM_SUB_BUCKET_BITS) + sub_bucket);
+}
+uint64_t GetHistogramBucketUpperBound(size_t bucket)
+{
+    const uint64_t sub_bucket_count = uint64_t(1) << HISTOGRAM_SUB_BUCKET_BITS;
+    if (bucket < sub_bucket_count)
+        return bucket;
+    if (bucket >= HISTOGRAM_OVERFLOW_BUCKET)
+        return numeric_limits<uint64_t>::max();
+
+    const int shift = static_cast<int>(bucket >> HISTOGRAM_SUB_BUCKET_BITS) - 1;
+    const uint64_t sub_bucket = bucket & (sub_bucket_count - 1);
+    return ((sub_bucket_count + sub_bucket) << shift) + (uint64_t(1) << shift) - 1;
+}
+
+uint64_t HistogramSnapshot::Percentile(double percentile) const
+{
+    if (count == 0)
+        return 0;
+
+    const uint64_t rank = max<uint64_t>(1, static_cast<uint64_t>(percentile / 100.0 * count + 0.5));
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < HISTOGRAM_BUCKET_COUNT; bucket++)
+    {
+        seen += buckets[bucket];
+        if (seen >= rank)
+            return GetHistogramBucketUpperBound(bucket);
+    }
+    return GetHistogramBucketUpperBound(HISTOGRAM_OVERFLOW_BUCKET);
+}
+double HistogramSnapshot::Mean() const
+{
+    return count == 0 ? 0.0 : static_cast<double>(sum) / count;
+}
+const HistogramSnapshot& MetricsSnapshot::operator[](MetricTimer timer) const
+{
+    return timers[static_cast<size_t>(timer)];
+}
+uint64_t MetricsSnapshot::operator[](MetricCounter counter) const
+{
+    return counters[static_cast<size_t>(counter)];
+}
+
+string_view GetMetricName(MetricTimer timer)
+{
+    switch (timer)
+    {
+    case MetricTimer::QUERY_PARSE:
+        return "query_parse";
+    case MetricTimer::POSTING_TRAVERSAL:
+        return "posting_traversal";
+    case MetricTimer::SCORING:
+        return "scoring";
+    case MetricTimer::TOP_K_SELECTION:
+        return "top_k_selection";
+    case MetricTimer::SNIPPET_GENERATION:
+        return "snippet_generation";
+    case MetricTimer::ADD_DOCUMENT:
+        return "add_document";
+    case MetricTimer::REMOVE_DOCUMENT:
+        return "remove_document";
+    case MetricTimer::SEGMENT_SEAL:
+        return "segment_seal";
+    case MetricTimer::SEGMENT_MERGE:
+        return "segment_merge";
+    default:
+        return "unknown";
+    }
+}
+string_view GetMetricName(MetricCounter counter)
+{
+    switch (counter)
+    {
+    case MetricCounter::QUERIES:
+        return "queries";
+    case MetricCounter::QUERIES_TRUNCATED:
+        return "queries_truncated";
+    case MetricCounter::POSTINGS_VISITED:
+        return "postings_visited";
+    case MetricCounter::DOCUMENTS_SCORED:
+        return "documents_scored";
+    case MetricCounter::DOCUMENTS_ADDED:
+        return "documents_added";
+    case MetricCounter::DOCUMENTS_REMOVED:
+        return "documents_removed";
+    default:
+        return "unknown";
+    }
+}
+
+void RecordDuration(MetricTimer timer, uint64_t nanoseconds)
+{
+    ThreadShard& shard = GetThreadShard();
+    const size_t index = static_cast<size_t>(timer);
+    AddRelaxed(shard.buckets[index][GetHistogramBucket(nanoseconds)], 1);
+    AddRelaxed(shard.counts[index], 1);
+    AddRelaxed(shard.sums[index], nanoseconds);
+}
+void IncrementCounter(MetricCounter counter, uint64_t value)
+{
+    AddRelaxed(GetThreadShard().counters[static_cast<size_t>(counter)], value);
+}
+
+MetricsSnapshot GetMetricsSnapshot()
+{
+    return GetRegistry().Collect();
+}
+void ResetMetrics()
+{
+    GetRegistry().Reset();
+}
+void PrintPrometheusMetrics(ostream& out)
+{
+    const MetricsSnapshot snapshot = GetMetricsSnapshot();
+
+    for (size_t counter = 0; counter < COUNTER_COUNT; counter++)
+    {
+        const string_view name = GetMetricName(static_cast<MetricCounter>(counter));
+        out << "# TYPE search_server_" << name << "_total counter\n";
+        out << "search_server_" << name << "_total " << snapshot.counters[counter] << '\n';
+    }
+    for (size_t timer = 0; timer < TIMER_COUNT; timer++)
+    {
+        const string_view name = GetMetricName(static_cast<MetricTimer>(timer));
+        const HistogramSnapshot& histogram = snapshot.timers[timer];
+        out << "# TYPE search_server_" << name << "_seconds histogram\n";
+
+        // The set of le labels has to be the same in every scrape for rates and quantiles, so empty buckets are written too.
+        // HDR buckets are summed up into them, every bound is the exact upper bound of the last HDR bucket under it
+        uint64_t cumulative = 0;
+        size_t bucket = 0;
+        for (int exponent = PROMETHEUS_MIN_EXPONENT; exponent <= HISTOGRAM_MAX_EXPONENT; exponent += PROMETHEUS_EXPONENT_STEP)
+        {
+            const uint64_t upper_bound = (uint64_t(1) << exponent) - 1;
+            for (; bucket <= GetHistogramBucket(upper_bound); bucket++)
+            {
+                cumulative += histogram.buckets[bucket];
+            }
+            out << "search_server_" << name << "_seconds_bucket{le=\"" << FormatSeconds(upper_bound) << "\"} " << cumulative << '\n';
+        }
+        out << "search_server_" << name << "_seconds_bucket{le=\"+Inf\"} " << histogram.count << '\n';
+        out << "search_server_" << name << "_seconds_sum " << FormatSeconds(histogram.sum) << '\n';
+        out << "search_server_" << name << "_seconds_count " << histogram.count << '\n';
+    }
+}
\ No newline at end of file
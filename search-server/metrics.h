@@ -0,0 +1,114 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+// Low overhead hot path instrumentation.
+// Every thread writes into its own shard of relaxed atomics, so recording never takes a lock and never bounces cache lines
+// between threads. Shards are only summed up when a snapshot is requested.
+// Define SEARCH_SERVER_DISABLE_METRICS to compile all of the recording macros out.
+
+enum class MetricTimer
+{
+    QUERY_PARSE,
+    POSTING_TRAVERSAL,
+    SCORING,
+    TOP_K_SELECTION,
+    SNIPPET_GENERATION,
+    ADD_DOCUMENT,
+    REMOVE_DOCUMENT,
+    SEGMENT_SEAL,
+    SEGMENT_MERGE,
+    COUNT
+};
+enum class MetricCounter
+{
+    QUERIES,
+    QUERIES_TRUNCATED, // Stopped by their deadline or cancellation
+    POSTINGS_VISITED,
+    DOCUMENTS_SCORED,
+    DOCUMENTS_ADDED,
+    DOCUMENTS_REMOVED,
+    COUNT
+};
+
+const size_t TIMER_COUNT = static_cast<size_t>(MetricTimer::COUNT);
+const size_t COUNTER_COUNT = static_cast<size_t>(MetricCounter::COUNT);
+
+// HDR-style log-linear buckets: every power of two is split into 2^HISTOGRAM_SUB_BUCKET_BITS linear sub buckets,
+// which keeps relative error under 1/2^HISTOGRAM_SUB_BUCKET_BITS from 1 ns up to 2^(HISTOGRAM_MAX_EXPONENT + 1) ns (~36 minutes).
+// Values under 2^HISTOGRAM_SUB_BUCKET_BITS take one group of buckets, every power of two from there on takes another one.
+// Anything longer goes into the last, overflow bucket, that has no upper bound
+const int HISTOGRAM_SUB_BUCKET_BITS = 3;
+const int HISTOGRAM_MAX_EXPONENT = 40;
+const size_t HISTOGRAM_OVERFLOW_BUCKET = static_cast<size_t>(HISTOGRAM_MAX_EXPONENT - HISTOGRAM_SUB_BUCKET_BITS + 2) << HISTOGRAM_SUB_BUCKET_BITS;
+const size_t HISTOGRAM_BUCKET_COUNT = HISTOGRAM_OVERFLOW_BUCKET + 1;
+const int PROMETHEUS_MIN_EXPONENT = 8; // 256 ns
+const int PROMETHEUS_EXPONENT_STEP = 2;
+
+size_t GetHistogramBucket(uint64_t nanoseconds);
+uint64_t GetHistogramBucketUpperBound(size_t bucket); // Largest value, that still falls into the bucket; UINT64_MAX for the overflow bucket
+
+struct HistogramSnapshot
+{
+    uint64_t count = 0;
+    uint64_t sum = 0; // ns
+    std::array<uint64_t, HISTOGRAM_BUCKET_COUNT> buckets{};
+
+    uint64_t Percentile(double percentile) const; // Upper bound of the bucket, where percentile (0..100) falls, in ns
+    double Mean() const;
+};
+struct MetricsSnapshot
+{
+    std::array<HistogramSnapshot, TIMER_COUNT> timers;
+    std::array<uint64_t, COUNTER_COUNT> counters{};
+
+    const HistogramSnapshot& operator[](MetricTimer timer) const;
+    uint64_t operator[](MetricCounter counter) const;
+};
+
+std::string_view GetMetricName(MetricTimer timer);
+std::string_view GetMetricName(MetricCounter counter);
+
+void RecordDuration(MetricTimer timer, uint64_t nanoseconds);
+void IncrementCounter(MetricCounter counter, uint64_t value = 1);
+
+MetricsSnapshot GetMetricsSnapshot(); // Sum of all threads, including the ones that already exited
+void ResetMetrics(); // Following snapshots only count what was recorded after this call
+// Prometheus text exposition format. Histograms are exported with a fixed set of le bounds, every second power of two
+// from 2^PROMETHEUS_MIN_EXPONENT ns on, minus one ns: these are upper bounds of HDR buckets, so the cumulative counts are exact
+void PrintPrometheusMetrics(std::ostream& out);
+
+class ScopedTimer
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit ScopedTimer(MetricTimer timer) : timer_(timer) { }
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    ~ScopedTimer()
+    {
+        RecordDuration(timer_, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start_time_).count()));
+    }
+
+private:
+    const MetricTimer timer_;
+    const Clock::time_point start_time_ = Clock::now();
+};
+
+#define METRICS_CONCAT_INTERNAL(X, Y) X##Y
+#define METRICS_CONCAT(X, Y) METRICS_CONCAT_INTERNAL(X, Y)
+
+#ifdef SEARCH_SERVER_DISABLE_METRICS
+#define METRIC_TIMER(timer) ((void)0)
+#define METRIC_COUNT(counter, value) ((void)0)
+#else
+#define METRIC_TIMER(timer) ScopedTimer METRICS_CONCAT(metricsGuard, __LINE__)(timer)
+#define METRIC_COUNT(counter, value) IncrementCounter(counter, value)
+#endif
@@ -0,0 +1,109 @@
+#include "quantized_scoring.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+// AVX2 kernel is compiled for its own function only and chosen at run time, so the binary still runs on older CPUs
+#if !defined(SEARCH_SERVER_DISABLE_AVX2) && (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define SEARCH_SERVER_AVX2_KERNEL
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+namespace
+{
+#ifdef SEARCH_SERVER_AVX2_KERNEL
+    __attribute__((target("avx2")))
+    void AddAvx2(uint32_t* scores, const uint32_t* ordinals, const uint16_t* term_frequencies, size_t count, uint32_t idf)
+    {
+        const __m256i idf_vector = _mm256_set1_epi32(static_cast<int>(idf));
+        const __m256i flag = _mm256_set1_epi32(static_cast<int>(MATCHED_SCORE_FLAG));
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            // Block of 8 postings: widen TF to 32 bits, gather current scores, add the products and write them back.
+            // AVX2 has no scatter, but ordinals within a partition are distinct, so plain stores never collide
+            const __m256i index = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ordinals + i));
+            const __m256i term_frequency = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(term_frequencies + i)));
+            const __m256i score = _mm256_i32gather_epi32(reinterpret_cast<const int*>(scores), index, 4);
+            const __m256i sum = _mm256_or_si256(_mm256_add_epi32(score, _mm256_mullo_epi32(term_frequency, idf_vector)), flag);
+            alignas(32) uint32_t sums[8];
+            _mm256_store_si256(reinterpret_cast<__m256i*>(sums), sum);
+            for (size_t lane = 0; lane < 8; lane++)
+            {
+                scores[ordinals[i + lane]] = sums[lane];
+            }
+        }
+        for (; i < count; i++)
+        {
+            scores[ordinals[i]] = (scores[ordinals[i]] + static_cast<uint32_t>(term_frequencies[i]) * idf) | MATCHED_SCORE_FLAG;
+        }
+    }
+#endif
+}
+
+uint16_t QuantizeTermFrequency(double term_frequency)
+{
+    // Every posting has to keep a non zero weight, even in a huge document
+    return static_cast<uint16_t>(clamp(lround(term_frequency * TERM_FREQUENCY_SCALE), 1l, static_cast<long>(TERM_FREQUENCY_SCALE)));
+}
+
+QuantizedScale::QuantizedScale(const vector<double>& word_idfs)
+{
+    // Score of a document is at most TERM_FREQUENCY_SCALE * sum of fixed point IDFs, which must stay under MAX_QUANTIZED_SCORE.
+    // IDFs are rounded down, so the sum never goes over, however the roundings add up
+    const double idf_sum = accumulate(word_idfs.begin(), word_idfs.end(), 0.0);
+    if (idf_sum > 0.0)
+        idf_scale = MAX_QUANTIZED_SCORE / (TERM_FREQUENCY_SCALE * idf_sum);
+
+    for (double idf : word_idfs)
+    {
+        idfs.push_back(static_cast<uint32_t>(idf * idf_scale));
+        // TF is off by half a unit at most and IDF by one unit, as TF <= 1
+        error_bound += idf * 0.5 / TERM_FREQUENCY_SCALE + (idf_scale > 0.0 ? (1.0 + 0.5 / TERM_FREQUENCY_SCALE) / idf_scale : 0.0);
+    }
+}
+double QuantizedScale::ToRelevance(uint32_t score) const
+{
+    return idf_scale > 0.0 ? score / (TERM_FREQUENCY_SCALE * idf_scale) : 0.0;
+}
+
+bool IsHigherScored(const QuantizedCandidate& lhs, const QuantizedCandidate& rhs)
+{
+    if (lhs.score != rhs.score)
+        return lhs.score > rhs.score;
+    if (lhs.rating != rhs.rating)
+        return lhs.rating > rhs.rating;
+    return lhs.document_id < rhs.document_id;
+}
+
+void QuantizedAccumulator::Reset(size_t document_count)
+{
+    scores.assign(document_count, 0);
+}
+void QuantizedAccumulator::Add(span<const uint32_t> ordinals, span<const uint16_t> term_frequencies, uint32_t idf)
+{
+#ifdef SEARCH_SERVER_AVX2_KERNEL
+    if (IsAvx2KernelEnabled())
+    {
+        AddAvx2(scores.data(), ordinals.data(), term_frequencies.data(), ordinals.size(), idf);
+        return;
+    }
+#endif
+    for (size_t i = 0; i < ordinals.size(); i++)
+    {
+        Add(ordinals[i], term_frequencies[i], idf);
+    }
+}
+
+bool IsAvx2KernelEnabled()
+{
+#ifdef SEARCH_SERVER_AVX2_KERNEL
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+#else
+    return false;
+#endif
+}
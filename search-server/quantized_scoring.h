@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Scoring mode, that ranks by fixed point integers instead of doubles. Term frequencies are kept in sealed segments
+// as 1/65535 units, IDF of the query words is scaled per query, so the score of any document fits into 31 bits.
+// Scores are accumulated into a dense array per segment and ordered exactly, without EPSILON.
+// Used the same way as std::execution::seq
+struct QuantizedPolicy
+{
+};
+inline constexpr QuantizedPolicy quantized_policy{};
+
+const double TERM_FREQUENCY_SCALE = 65535.0;
+const uint32_t MATCHED_SCORE_FLAG = 0x80000000u; // Marks every document with a plus word, even if its score rounds down to 0
+const uint32_t MAX_QUANTIZED_SCORE = MATCHED_SCORE_FLAG - 1;
+
+uint16_t QuantizeTermFrequency(double term_frequency); // term_frequency is in (0, 1]
+
+// Fixed point IDF of the plus words of one query
+class QuantizedScale
+{
+public:
+    explicit QuantizedScale(const std::vector<double>& idfs);
+
+    uint32_t GetIdf(size_t word_index) const
+    {
+        return idfs[word_index];
+    }
+    double ToRelevance(uint32_t score) const; // score has to be without MATCHED_SCORE_FLAG
+    double GetErrorBound() const
+    {
+        return error_bound;
+    } // Largest difference between ToRelevance and the double relevance of the same document
+
+private:
+    std::vector<uint32_t> idfs;
+    double idf_scale = 0.0; // Fixed point units per IDF unit
+    double error_bound = 0.0;
+};
+
+// Candidate of the quantized top K, ordered exactly: score, then rating, then lower id.
+// The order is total, so the result does not depend on how documents are spread between segments
+struct QuantizedCandidate
+{
+    uint32_t score;
+    int rating;
+    int document_id;
+};
+bool IsHigherScored(const QuantizedCandidate& lhs, const QuantizedCandidate& rhs);
+
+// Scores of all documents of one segment, indexed by their ordinal in the segment
+class QuantizedAccumulator
+{
+public:
+    void Reset(size_t document_count);
+    // Ordinals of one posting partition are distinct, which lets the AVX2 kernel gather and store 8 scores at once
+    void Add(std::span<const uint32_t> ordinals, std::span<const uint16_t> term_frequencies, uint32_t idf);
+    void Add(uint32_t ordinal, uint16_t term_frequency, uint32_t idf)
+    {
+        scores[ordinal] = (scores[ordinal] + static_cast<uint32_t>(term_frequency) * idf) | MATCHED_SCORE_FLAG;
+    }
+    void Exclude(uint32_t ordinal)
+    {
+        scores[ordinal] = 0;
+    }
+    std::span<const uint32_t> GetScores() const
+    {
+        return scores;
+    }
+
+private:
+    std::vector<uint32_t> scores;
+};
+
+bool IsAvx2KernelEnabled(); // AVX2 kernel is built in (see SEARCH_SERVER_AVX2 in CMakeLists.txt) and the CPU supports it
@@ -1,38 +1,34 @@
-#include "remove_duplicates.h"
-
-using namespace std;
-
-void RemoveDuplicates(SearchServer& search_server)
-{
-	if (search_server.GetDocumentCount() < 2)
-		return;
-
-	vector<int> removed_ids;
-	set<vector<string_view>> unic_docs;
-
-	for (int doc_id : search_server)
-	{
-		map<string_view, double> word_frequencies = search_server.GetWordFrequencies(doc_id);
-		vector<string_view> unic_words;
-		for (const auto& [key, value] : word_frequencies)
-		{
-			unic_words.push_back(key);
-		}
-
-		if (unic_docs.count(unic_words) > 0)
-			removed_ids.push_back(doc_id);
-		else
-			unic_docs.insert(unic_words);
-	}
-
-	sort(removed_ids.begin(), removed_ids.end());
-
-	if (removed_ids.size() != 0)
-	{
-		for (int doc_id : removed_ids)
-		{
-			search_server.RemoveDocument(doc_id);
-			cout << "Found duplicate document id " << doc_id << endl;
-		}
-	}
+#include "remove_duplicates.h"
+
+using namespace std;
+
+void RemoveDuplicates(SearchServer& search_server)
+{
+	if (search_server.GetDocumentCount() < 2)
+		return;
+
+	vector<int> removed_ids;
+	set<vector<int>> unic_docs;
+
+	for (int doc_id : search_server)
+	{
+		// Same words have the same ids, so sets of word ids from the forward index are compared without building any map
+		vector<int> unic_words = search_server.GetWordIds(doc_id);
+
+		if (unic_docs.count(unic_words) > 0)
+			removed_ids.push_back(doc_id);
+		else
+			unic_docs.insert(unic_words);
+	}
+
+	sort(removed_ids.begin(), removed_ids.end());
+
+	if (removed_ids.size() != 0)
+	{
+		for (int doc_id : removed_ids)
+		{
+			search_server.RemoveDocument(doc_id);
+			cout << "Found duplicate document id " << doc_id << endl;
+		}
+	}
 }
\ No newline at end of file
@@ -1,10 +1,10 @@
-#pragma once
-
-#include <map>
-#include <vector>
-#include <set>
-#include <string>
-
-#include "search_server.h"
-
+#pragma once
+
+#include <map>
+#include <vector>
+#include <set>
+#include <string>
+
+#include "search_server.h"
+
 void RemoveDuplicates(SearchServer& search_server);
\ No newline at end of file
@@ -1,35 +1,45 @@
-#include "request_queue.h"
-
-using namespace std;
-
-vector<Document> RequestQueue::AddFindRequest(const string& raw_query, DocumentStatus status)
-{
-    vector<Document> result = search_server_reference.FindTopDocuments(raw_query, status);
-
-    requests.push_back(Paginate(result, PAGE_LENGTH));
-    if (requests.size() > min_in_day)
-        requests.pop_front();
-
-    return result;
-}
-vector<Document> RequestQueue::AddFindRequest(const string& raw_query)
-{
-    vector<Document> result = search_server_reference.FindTopDocuments(raw_query);
-
-    requests.push_back(Paginate(result, PAGE_LENGTH));
-    if (requests.size() > min_in_day)
-        requests.pop_front();
-
-    return result;
-}
-
-int RequestQueue::GetNoResultRequests() const
-{
-    int result = 0;
-    for (Paginator q : requests)
-    {
-        if (q.size() == 0)
-            result++;
-    }
-    return result;
+#include "request_queue.h"
+
+using namespace std;
+
+vector<Document> RequestQueue::AddFindRequest(const string& raw_query, DocumentStatus status)
+{
+    vector<Document> result = search_server_reference.FindTopDocuments(raw_query, status);
+
+    requests.push_back(Paginate(result, PAGE_LENGTH));
+    if (requests.size() > min_in_day)
+        requests.pop_front();
+
+    return result;
+}
+vector<Document> RequestQueue::AddFindRequest(const string& raw_query)
+{
+    vector<Document> result = search_server_reference.FindTopDocuments(raw_query);
+
+    requests.push_back(Paginate(result, PAGE_LENGTH));
+    if (requests.size() > min_in_day)
+        requests.pop_front();
+
+    return result;
+}
+
+MemoryUsage RequestQueue::GetMemoryUsage() const
+{
+    // Blocks of the deque are counted by the elements they hold, which slightly underestimates the last one
+    MemoryUsage usage = { requests.size() * sizeof(Paginator), requests.empty() ? size_t(0) : size_t(1) };
+    for (const Paginator& paginator : requests)
+    {
+        usage += paginator.GetMemoryUsage();
+    }
+    return usage;
+}
+int RequestQueue::GetNoResultRequests() const
+{
+    int result = 0;
+    for (Paginator q : requests)
+    {
+        if (q.size() == 0)
+            result++;
+    }
+    return result;
 }
\ No newline at end of file
@@ -0,0 +1,345 @@
+#include "roaring_bitmap.h"
+
+#include <algorithm>
+#include <bit>
+#include <iterator>
+
+using namespace std;
+
+bool RoaringBitmap::Container::Contains(uint16_t low) const
+{
+    if (IsBitset())
+        return (bitset[low >> 6] >> (low & 63)) & 1;
+    return binary_search(array.begin(), array.end(), low);
+}
+size_t RoaringBitmap::Container::GetMemoryUsage() const
+{
+    return array.capacity() * sizeof(uint16_t) + bitset.capacity() * sizeof(uint64_t);
+}
+void RoaringBitmap::Container::Add(uint16_t low)
+{
+    if (IsBitset())
+    {
+        uint64_t& word = bitset[low >> 6];
+        const uint64_t bit = uint64_t(1) << (low & 63);
+        cardinality += (word & bit) == 0;
+        word |= bit;
+        return;
+    }
+
+    const auto position = lower_bound(array.begin(), array.end(), low);
+    if (position != array.end() && *position == low)
+        return;
+    array.insert(position, low);
+    cardinality++;
+    Normalize();
+}
+void RoaringBitmap::Container::Remove(uint16_t low)
+{
+    if (IsBitset())
+    {
+        uint64_t& word = bitset[low >> 6];
+        const uint64_t bit = uint64_t(1) << (low & 63);
+        cardinality -= (word & bit) != 0;
+        word &= ~bit;
+    }
+    else
+    {
+        const auto position = lower_bound(array.begin(), array.end(), low);
+        if (position == array.end() || *position != low)
+            return;
+        array.erase(position);
+        cardinality--;
+    }
+    Normalize();
+}
+void RoaringBitmap::Container::Normalize()
+{
+    if (IsBitset() && cardinality <= ARRAY_CONTAINER_LIMIT)
+    {
+        array.clear();
+        array.reserve(cardinality);
+        for (size_t word = 0; word < BITSET_WORDS; word++)
+        {
+            for (uint64_t bits = bitset[word]; bits != 0; bits &= bits - 1)
+            {
+                array.push_back(static_cast<uint16_t>(word * 64 + countr_zero(bits)));
+            }
+        }
+        bitset.clear();
+        bitset.shrink_to_fit();
+    }
+    else if (!IsBitset() && cardinality > ARRAY_CONTAINER_LIMIT)
+    {
+        bitset = ToBitset();
+        array.clear();
+        array.shrink_to_fit();
+    }
+}
+vector<uint64_t> RoaringBitmap::Container::ToBitset() const
+{
+    if (IsBitset())
+        return bitset;
+
+    vector<uint64_t> words(BITSET_WORDS, 0);
+    for (uint16_t low : array)
+    {
+        words[low >> 6] |= uint64_t(1) << (low & 63);
+    }
+    return words;
+}
+RoaringBitmap::Container RoaringBitmap::Container::FromBitset(vector<uint64_t> words)
+{
+    Container result;
+    for (uint64_t word : words)
+    {
+        result.cardinality += popcount(word);
+    }
+    result.bitset = move(words);
+    result.Normalize();
+    return result;
+}
+
+RoaringBitmap::Container RoaringBitmap::Container::And(const Container& lhs, const Container& rhs)
+{
+    Container result;
+    if (lhs.IsBitset() && rhs.IsBitset())
+    {
+        vector<uint64_t> words(BITSET_WORDS);
+        for (size_t word = 0; word < BITSET_WORDS; word++)
+        {
+            words[word] = lhs.bitset[word] & rhs.bitset[word];
+        }
+        return FromBitset(move(words));
+    }
+    if (!lhs.IsBitset() && !rhs.IsBitset())
+        set_intersection(lhs.array.begin(), lhs.array.end(), rhs.array.begin(), rhs.array.end(), back_inserter(result.array));
+    else
+    {
+        const Container& sparse = lhs.IsBitset() ? rhs : lhs;
+        const Container& dense = lhs.IsBitset() ? lhs : rhs;
+        copy_if(sparse.array.begin(), sparse.array.end(), back_inserter(result.array), [&dense](uint16_t low) { return dense.Contains(low); });
+    }
+    result.cardinality = result.array.size();
+    return result; // Intersection is never larger than the sparse side, so it is already an array
+}
+RoaringBitmap::Container RoaringBitmap::Container::Or(const Container& lhs, const Container& rhs)
+{
+    if (!lhs.IsBitset() && !rhs.IsBitset() && lhs.cardinality + rhs.cardinality <= ARRAY_CONTAINER_LIMIT)
+    {
+        Container result;
+        set_union(lhs.array.begin(), lhs.array.end(), rhs.array.begin(), rhs.array.end(), back_inserter(result.array));
+        result.cardinality = result.array.size();
+        return result;
+    }
+
+    vector<uint64_t> words = lhs.ToBitset();
+    if (rhs.IsBitset())
+    {
+        for (size_t word = 0; word < BITSET_WORDS; word++)
+        {
+            words[word] |= rhs.bitset[word];
+        }
+    }
+    else
+    {
+        for (uint16_t low : rhs.array)
+        {
+            words[low >> 6] |= uint64_t(1) << (low & 63);
+        }
+    }
+    return FromBitset(move(words));
+}
+RoaringBitmap::Container RoaringBitmap::Container::AndNot(const Container& lhs, const Container& rhs)
+{
+    if (!lhs.IsBitset())
+    {
+        Container result;
+        copy_if(lhs.array.begin(), lhs.array.end(), back_inserter(result.array), [&rhs](uint16_t low) { return !rhs.Contains(low); });
+        result.cardinality = result.array.size();
+        return result;
+    }
+
+    vector<uint64_t> words = lhs.bitset;
+    if (rhs.IsBitset())
+    {
+        for (size_t word = 0; word < BITSET_WORDS; word++)
+        {
+            words[word] &= ~rhs.bitset[word];
+        }
+    }
+    else
+    {
+        for (uint16_t low : rhs.array)
+        {
+            words[low >> 6] &= ~(uint64_t(1) << (low & 63));
+        }
+    }
+    return FromBitset(move(words));
+}
+
+RoaringBitmap::RoaringBitmap(initializer_list<int> values) : RoaringBitmap(values.begin(), values.end())
+{
+}
+void RoaringBitmap::Add(uint32_t value)
+{
+    const uint16_t high = HighBits(value);
+    const auto position = lower_bound(keys.begin(), keys.end(), high);
+    const size_t index = position - keys.begin();
+    if (position == keys.end() || *position != high)
+    {
+        keys.insert(position, high);
+        containers.insert(containers.begin() + index, Container());
+    }
+    containers[index].Add(LowBits(value));
+}
+void RoaringBitmap::Remove(uint32_t value)
+{
+    const uint16_t high = HighBits(value);
+    const auto position = lower_bound(keys.begin(), keys.end(), high);
+    if (position == keys.end() || *position != high)
+        return;
+
+    const size_t index = position - keys.begin();
+    containers[index].Remove(LowBits(value));
+    if (containers[index].cardinality == 0)
+    {
+        keys.erase(position);
+        containers.erase(containers.begin() + index);
+    }
+}
+bool RoaringBitmap::Contains(uint32_t value) const
+{
+    const Container* container = FindContainer(HighBits(value));
+    return container != nullptr && container->Contains(LowBits(value));
+}
+bool RoaringBitmap::IsEmpty() const
+{
+    return keys.empty();
+}
+size_t RoaringBitmap::GetCardinality() const
+{
+    size_t result = 0;
+    for (const Container& container : containers)
+    {
+        result += container.cardinality;
+    }
+    return result;
+}
+size_t RoaringBitmap::GetMemoryUsage() const
+{
+    size_t result = keys.capacity() * sizeof(uint16_t) + containers.capacity() * sizeof(Container);
+    for (const Container& container : containers)
+    {
+        result += container.GetMemoryUsage();
+    }
+    return result;
+}
+vector<uint32_t> RoaringBitmap::ToVector() const
+{
+    vector<uint32_t> result;
+    result.reserve(GetCardinality());
+    for (size_t index = 0; index < keys.size(); index++)
+    {
+        const uint32_t high = static_cast<uint32_t>(keys[index]) << 16;
+        const Container& container = containers[index];
+        if (!container.IsBitset())
+        {
+            for (uint16_t low : container.array)
+            {
+                result.push_back(high | low);
+            }
+            continue;
+        }
+        for (size_t word = 0; word < BITSET_WORDS; word++)
+        {
+            for (uint64_t bits = container.bitset[word]; bits != 0; bits &= bits - 1)
+            {
+                result.push_back(high | static_cast<uint32_t>(word * 64 + countr_zero(bits)));
+            }
+        }
+    }
+    return result;
+}
+const RoaringBitmap::Container* RoaringBitmap::FindContainer(uint16_t high) const
+{
+    const auto position = lower_bound(keys.begin(), keys.end(), high);
+    if (position == keys.end() || *position != high)
+        return nullptr;
+    return &containers[position - keys.begin()];
+}
+
+RoaringBitmap operator&(const RoaringBitmap& lhs, const RoaringBitmap& rhs)
+{
+    RoaringBitmap result;
+    size_t i = 0, j = 0;
+    while (i < lhs.keys.size() && j < rhs.keys.size())
+    {
+        if (lhs.keys[i] < rhs.keys[j])
+            i++;
+        else if (rhs.keys[j] < lhs.keys[i])
+            j++;
+        else
+        {
+            RoaringBitmap::Container container = RoaringBitmap::Container::And(lhs.containers[i], rhs.containers[j]);
+            if (container.cardinality > 0)
+            {
+                result.keys.push_back(lhs.keys[i]);
+                result.containers.push_back(move(container));
+            }
+            i++;
+            j++;
+        }
+    }
+    return result;
+}
+RoaringBitmap operator|(const RoaringBitmap& lhs, const RoaringBitmap& rhs)
+{
+    RoaringBitmap result;
+    size_t i = 0, j = 0;
+    while (i < lhs.keys.size() || j < rhs.keys.size())
+    {
+        if (j == rhs.keys.size() || (i < lhs.keys.size() && lhs.keys[i] < rhs.keys[j]))
+        {
+            result.keys.push_back(lhs.keys[i]);
+            result.containers.push_back(lhs.containers[i++]);
+        }
+        else if (i == lhs.keys.size() || rhs.keys[j] < lhs.keys[i])
+        {
+            result.keys.push_back(rhs.keys[j]);
+            result.containers.push_back(rhs.containers[j++]);
+        }
+        else
+        {
+            result.keys.push_back(lhs.keys[i]);
+            result.containers.push_back(RoaringBitmap::Container::Or(lhs.containers[i++], rhs.containers[j++]));
+        }
+    }
+    return result;
+}
+RoaringBitmap AndNot(const RoaringBitmap& lhs, const RoaringBitmap& rhs)
+{
+    RoaringBitmap result;
+    size_t j = 0;
+    for (size_t i = 0; i < lhs.keys.size(); i++)
+    {
+        while (j < rhs.keys.size() && rhs.keys[j] < lhs.keys[i])
+        {
+            j++;
+        }
+        if (j == rhs.keys.size() || rhs.keys[j] != lhs.keys[i])
+        {
+            result.keys.push_back(lhs.keys[i]);
+            result.containers.push_back(lhs.containers[i]);
+            continue;
+        }
+
+        RoaringBitmap::Container container = RoaringBitmap::Container::AndNot(lhs.containers[i], rhs.containers[j]);
+        if (container.cardinality > 0)
+        {
+            result.keys.push_back(lhs.keys[i]);
+            result.containers.push_back(move(container));
+        }
+    }
+    return result;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+
+const size_t ARRAY_CONTAINER_LIMIT = 4096; // Above it an array takes more memory than a bitset (4096 * 2 bytes = 8 KB)
+const size_t BITSET_WORDS = 1024; // 2^16 bits
+
+inline uint16_t HighBits(uint32_t value)
+{
+    return static_cast<uint16_t>(value >> 16);
+}
+inline uint16_t LowBits(uint32_t value)
+{
+    return static_cast<uint16_t>(value & 0xFFFF);
+}
+
+// Compressed set of non negative integers (document ids) in the Roaring layout:
+// values are split into blocks by their high 16 bits, every block is stored in the container, that suits its density -
+// sorted array of low 16 bits for sparse blocks, 2^16 bit bitset for dense ones.
+// DocumentFilter holds bitmaps through shared_ptr to const, so callers can compose them once and cache the result
+class RoaringBitmap
+{
+public:
+    class Container
+    {
+    public:
+        bool Contains(uint16_t low) const;
+        size_t GetCardinality() const
+        {
+            return cardinality;
+        }
+        size_t GetMemoryUsage() const;
+
+    private:
+        friend class RoaringBitmap;
+        friend RoaringBitmap operator&(const RoaringBitmap& lhs, const RoaringBitmap& rhs);
+        friend RoaringBitmap operator|(const RoaringBitmap& lhs, const RoaringBitmap& rhs);
+        friend RoaringBitmap AndNot(const RoaringBitmap& lhs, const RoaringBitmap& rhs);
+
+        std::vector<uint16_t> array; // Sorted; used while cardinality <= ARRAY_CONTAINER_LIMIT
+        std::vector<uint64_t> bitset; // BITSET_WORDS words otherwise
+        size_t cardinality = 0;
+
+        bool IsBitset() const
+        {
+            return !bitset.empty();
+        }
+        void Add(uint16_t low);
+        void Remove(uint16_t low);
+        void Normalize(); // Switches to the representation, that suits current cardinality
+        std::vector<uint64_t> ToBitset() const;
+
+        static Container FromBitset(std::vector<uint64_t> words);
+        static Container And(const Container& lhs, const Container& rhs);
+        static Container Or(const Container& lhs, const Container& rhs);
+        static Container AndNot(const Container& lhs, const Container& rhs);
+    };
+
+    RoaringBitmap() = default;
+    RoaringBitmap(std::initializer_list<int> values);
+    template <typename It>
+    RoaringBitmap(It begin, It end)
+    {
+        for (It it = begin; it != end; ++it)
+        {
+            Add(static_cast<uint32_t>(*it));
+        }
+    }
+
+    void Add(uint32_t value);
+    void Remove(uint32_t value);
+    bool Contains(uint32_t value) const;
+    bool IsEmpty() const;
+    size_t GetCardinality() const;
+    size_t GetMemoryUsage() const; // bytes
+    std::vector<uint32_t> ToVector() const;
+
+    const Container* FindContainer(uint16_t high) const; // nullptr, if none of the values has such high 16 bits
+
+    friend RoaringBitmap operator&(const RoaringBitmap& lhs, const RoaringBitmap& rhs);
+    friend RoaringBitmap operator|(const RoaringBitmap& lhs, const RoaringBitmap& rhs);
+    friend RoaringBitmap AndNot(const RoaringBitmap& lhs, const RoaringBitmap& rhs);
+
+private:
+    std::vector<uint16_t> keys; // Sorted high 16 bits
+    std::vector<Container> containers; // [index of the key]
+};
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <chrono>
+#include <stop_token>
+
+// Cooperative limit of one search. Posting traversal checks it between blocks of postings and stops, once the deadline
+// has passed or stop is requested. Once reached, it stays reached, so the caller can tell, whether the result is cut short
+class SearchDeadline
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    SearchDeadline(Clock::time_point deadline, std::stop_token stop_token) : deadline(deadline), stop_token(std::move(stop_token)) {}
+
+    bool IsReached()
+    {
+        if (!reached)
+            reached = stop_token.stop_requested() || Clock::now() >= deadline;
+        return reached;
+    }
+    bool WasReached() const
+    {
+        return reached;
+    } // Without checking the clock: true only if some check has already stopped the search
+
+private:
+    Clock::time_point deadline;
+    std::stop_token stop_token;
+    bool reached = false;
+};
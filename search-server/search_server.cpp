@@ -1,279 +1,1113 @@
-#include "search_server.h"
-
-using namespace std;
-
-bool IsValidWord(string_view word)
-{
-    return none_of(word.begin(), word.end(), [](char c) { return c >= 0 && c <= 31; });
-}
-bool IsCorrectMinus(string_view word)
-{
-    if (word == "-")
-        return false; // last char is not minus
-    if (word[1] == '-') // couldn't be done in one if; will result in error if word has only ona character
-        return false;
-    return true;
-}
-bool IsMinusWord(string_view word)
-{
-    if (word[0] == '-')
-    {
-        if (IsCorrectMinus(word))
-            return true;
-        else
-            throw invalid_argument("Word: " + static_cast<string>(word) + "; incorrect minus word.");
-    }
-    else
-        return false;
-}
-int ComputeIntegerAverage(const vector<int>& values)
-{
-    int size = static_cast<int>(values.size());
-
-    if (size == 0)
-        return 0;
-    else
-        return accumulate(values.begin(), values.end(), 0) / size;
-} // Basic average, exept result will be integer (not sure why)
-
-void SearchServer::AddDocument(int document_id, string_view text_document, DocumentStatus status, const vector<int>& ratings)
-{
-    if (document_id < 0)
-        throw invalid_argument("id can't be negative. Got: " + document_id + '.');
-    if (doc_rating_status.count(document_id) > 0)
-        throw invalid_argument("This id already exists: " + document_id + '.');
-
-    documents[document_id] = static_cast<string>(text_document);
-
-    const vector<string_view> words = SplitIntoWordsNoStop(documents[document_id]);
-    for (const string_view& word : words)
-    {
-        if (!IsValidWord(word))
-            throw invalid_argument("Word: " + static_cast<string>(word) + "; contains a special symbol.");
-    }
-
-    const double inv_word_count = 1.0 / words.size();
-    for (const string_view& word : words)
-    {
-        word_to_document_freqs[word][document_id] += inv_word_count;
-        document_word_frequencies[document_id][word] += inv_word_count;
-    }
-
-    doc_rating_status[document_id] = { ComputeIntegerAverage(ratings), status };
-    ids.insert(document_id);
-}
-void SearchServer::RemoveDocument(int document_id)
-{
-    ids.erase(find(ids.begin(), ids.end(), document_id));
-    doc_rating_status.erase(document_id);
-
-    for (const auto& [word, frequency] : document_word_frequencies[document_id])
-    {
-        word_to_document_freqs[word].erase(document_id);
-    }
-
-    document_word_frequencies.erase(document_id);
-}
-void SearchServer::RemoveDocument(execution::sequenced_policy policy, int document_id)
-{
-    SearchServer::RemoveDocument(document_id);
-}
-void SearchServer::RemoveDocument(execution::parallel_policy policy, int document_id)
-{
-    ids.erase(find(ids.begin(), ids.end(), document_id));
-    doc_rating_status.erase(document_id);
-
-    vector<const string_view*> elements_to_remove(document_word_frequencies.at(document_id).size());
-    transform
-    (
-        execution::par, document_word_frequencies.at(document_id).begin(), document_word_frequencies.at(document_id).end(), elements_to_remove.begin(),
-        [](pair<const string_view, double>& item) { return &item.first; }
-    );
-
-    for_each
-    (
-        execution::par, elements_to_remove.begin(), elements_to_remove.end(),
-        [this, &document_id](const string_view* item)
-        {
-            word_to_document_freqs[*item].erase(document_id);
-        }
-    );
-
-    document_word_frequencies.erase(document_id);
-}
-
-vector<Document> SearchServer::FindTopDocuments(string_view raw_query, DocumentStatus status) const
-{
-    return FindTopDocuments(raw_query, [status](int document_id, DocumentStatus doc_status, int rating) { return doc_status == status; });
-} // Finds all matched documents (matching is determined by the status), then returns top ones (determine by MAX_RESULT_DOCUMENT_COUNT const)
-vector<Document> SearchServer::FindTopDocuments(execution::sequenced_policy, string_view raw_query, DocumentStatus status) const
-{
-    return FindTopDocuments(raw_query, status);
-} // Finds all matched documents (matching is determined by the status), then returns top ones (determine by MAX_RESULT_DOCUMENT_COUNT const)
-vector<Document> SearchServer::FindTopDocuments(execution::parallel_policy, string_view raw_query, DocumentStatus status) const
-{
-    return FindTopDocuments(execution::par, raw_query, [status](int document_id, DocumentStatus doc_status, int rating) { return doc_status == status; });
-} // Finds all matched documents (matching is determined by the status), then returns top ones (determine by MAX_RESULT_DOCUMENT_COUNT const)
-
-tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(string_view raw_query, int document_id) const
-{
-    vector<string_view> matched_words;
-
-    if (!ids.contains(document_id))
-        return tuple(matched_words, doc_rating_status.at(document_id).status);
-
-    Query query = ParseQuery(raw_query);
-    // Firstly, check if there are any stop words, so we won`t have to do the rest
-    for (string_view word : query.minus_words)
-    {
-        if (!word_to_document_freqs.contains(word))
-            return tuple(matched_words, doc_rating_status.at(document_id).status);
-
-        if (word_to_document_freqs.at(word).count(document_id) != 0)
-            return tuple(matched_words, doc_rating_status.at(document_id).status);
-    }
-    // If there is no minus words here, then find matches
-    for (string_view word : query.plus_words)
-    {
-        if (word_to_document_freqs.count(word) == 0)
-            continue;
-
-        if (word_to_document_freqs.at(word).count(document_id) != 0)
-        {
-            matched_words.push_back(word);
-        }
-    }
-    return tuple(matched_words, doc_rating_status.at(document_id).status);
-}
-tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(execution::sequenced_policy policy, string_view raw_query, int document_id) const
-{
-    return SearchServer::MatchDocument(raw_query, document_id);
-}
-tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(execution::parallel_policy policy, string_view raw_query, int document_id) const
-{
-    vector<string_view> matched_words;
-
-    if (!ids.contains(document_id))
-        return tuple(matched_words, doc_rating_status.at(document_id).status);
-
-    Query query = ParseQuery(policy, raw_query);
-    // Firstly, check if there are any stop words, so we won`t have to do the rest
-
-    if (any_of(policy, query.minus_words.begin(), query.minus_words.end(), [this, &document_id](const string_view& word) { return document_word_frequencies.at(document_id).contains(word); }))
-        return tuple(matched_words, doc_rating_status.at(document_id).status);
-
-    matched_words.resize(query.plus_words.size());
-
-    matched_words.resize(
-        copy_if
-        (
-            policy, query.plus_words.begin(), query.plus_words.end(), matched_words.begin(),
-            [this, &document_id](const string_view& word)
-            {
-                return word_to_document_freqs.at(word).contains(document_id);
-            }
-        ) - matched_words.begin()
-    );
-
-    sort(policy, matched_words.begin(), matched_words.end());
-    matched_words.erase(unique(policy, matched_words.begin(), matched_words.end()), matched_words.end());
-
-    return tuple(matched_words, doc_rating_status.at(document_id).status);
-}
-int SearchServer::GetDocumentCount() const
-{
-    return static_cast<int>(doc_rating_status.size());
-}
-const map<string_view, double>& SearchServer::GetWordFrequencies(int document_id) const
-{
-    const static map<string_view, double> result;
-
-    //Tiny optimization
-    if (ids.count(document_id) == 0)
-        return result;
-
-    return document_word_frequencies.at(document_id);
-}
-
-bool SearchServer::IsStopWord(string_view word) const
-{
-    return stop_words.count(word) > 0;
-} // check if it is a non relevant word
-SearchServer::Word SearchServer::ValidateWord(string_view word) const
-{
-    Word valid_word;
-    valid_word.word = word;
-    if (!IsValidWord(word))
-        throw invalid_argument("Word: " + static_cast<string>(word) + "; contains a special symbol.");
-    if (IsMinusWord(word))
-    {
-        valid_word.word.remove_prefix(1); // removes minus from the word
-        valid_word.status = WordStatus::Minus;
-        return valid_word;
-    }
-    valid_word.status = WordStatus::Plus;
-    return valid_word;
-}
-vector<string_view> SearchServer::SplitIntoWordsNoStop(string_view text) const
-{
-    vector<string_view> words;
-    for (const string_view& word : SplitIntoWords(text))
-    {
-        if (!IsStopWord(word))
-            words.push_back(word);
-    }
-    return words;
-} // Parse text, excluding non important words
-SearchServer::Query SearchServer::ParseQuery(string_view text) const
-{
-    Query query;
-    for (string_view& word : SplitIntoWords(text))
-    {
-        Word valid_word = ValidateWord(word);
-        if (IsStopWord(valid_word.word))
-            continue;
-
-        if (valid_word.status == WordStatus::Minus)
-            query.minus_words.push_back(valid_word.word);
-        else
-            query.plus_words.push_back(valid_word.word);
-    }
-
-    sort(query.plus_words.begin(), query.plus_words.end());
-    query.plus_words.erase(unique(query.plus_words.begin(), query.plus_words.end()), query.plus_words.end());
-    sort(query.minus_words.begin(), query.minus_words.end());
-    query.minus_words.erase(unique(query.minus_words.begin(), query.minus_words.end()), query.minus_words.end());
-
-
-    return query;
-}
-SearchServer::Query SearchServer::ParseQuery(execution::sequenced_policy policy, string_view text) const
-{
-    return SearchServer::ParseQuery(text);
-}
-SearchServer::Query SearchServer::ParseQuery(execution::parallel_policy policy, string_view text) const
-{
-    Query query;
-    vector<string_view> parsed = SplitIntoWords(text);
-
-    for (string_view& word : parsed)
-    {
-        Word valid_word = ValidateWord(word);
-        if (IsStopWord(valid_word.word))
-            continue;
-
-        if (valid_word.status == WordStatus::Minus)
-            query.minus_words.push_back(valid_word.word);
-        else
-            query.plus_words.push_back(valid_word.word);
-    }
-
-    return query;
-}
-
-double SearchServer::CalculateIDF(string_view word) const
-{
-    double relevance = log(static_cast<int>(doc_rating_status.size()) / static_cast<double>(word_to_document_freqs.at(word).size()));
-
-    return relevance;
-} // Inverse Document Frequency for word
\ No newline at end of file
+#include "search_server.h"
+
+using namespace std;
+
+bool IsValidWord(string_view word)
+{
+    return none_of(word.begin(), word.end(), [](char c) { return c >= 0 && c <= 31; });
+}
+bool IsCorrectMinus(string_view word)
+{
+    if (word == "-")
+        return false; // last char is not minus
+    if (word[1] == '-') // couldn't be done in one if; will result in error if word has only ona character
+        return false;
+    return true;
+}
+bool IsMinusWord(string_view word)
+{
+    if (word[0] == '-')
+    {
+        if (IsCorrectMinus(word))
+            return true;
+        else
+            throw invalid_argument("Word: " + static_cast<string>(word) + "; incorrect minus word.");
+    }
+    else
+        return false;
+}
+bool IsPrefixWord(string_view word)
+{
+    return word.size() > 1 && word.back() == '*';
+} // Lone "*" is an ordinary word
+bool IsFuzzyWord(string_view word)
+{
+    if (word.size() > 1 && word.back() == '~')
+        return true;
+    return word.size() > 2 && word[word.size() - 2] == '~' && isdigit(static_cast<unsigned char>(word.back()));
+}
+int ComputeIntegerAverage(const vector<int>& values)
+{
+    int size = static_cast<int>(values.size());
+
+    if (size == 0)
+        return 0;
+    else
+        return accumulate(values.begin(), values.end(), 0) / size;
+} // Basic average, exept result will be integer (not sure why)
+
+MemoryUsage SearchServerMemoryStats::GetTotal() const
+{
+    return documents + forward_index + dictionary + stop_words + doc_rating_status + ids + segments;
+}
+
+void SearchServer::AddDocument(int document_id, string_view text_document, DocumentStatus status, const vector<int>& ratings)
+{
+    if (document_id < 0)
+        throw invalid_argument("id can't be negative. Got: " + to_string(document_id) + '.');
+
+    METRIC_TIMER(MetricTimer::ADD_DOCUMENT);
+    unique_lock lock(index_mutex);
+    if (ids.count(document_id) > 0)
+        throw invalid_argument("This id already exists: " + to_string(document_id) + '.');
+
+    const pmr::string& text = documents.emplace(document_id, text_document).first->second;
+
+    const vector<string_view> words = SplitIntoWordsNoStop(text);
+    for (const string_view& word : words)
+    {
+        if (!IsValidWord(word))
+        {
+            documents.erase(document_id);
+            throw invalid_argument("Word: " + static_cast<string>(word) + "; contains a special symbol.");
+        }
+    }
+
+    const int rating = ComputeIntegerAverage(ratings);
+    const double inv_word_count = 1.0 / words.size();
+    map<int, double> word_frequencies; // [word id, term frequency]
+    for (const string_view& word : words)
+    {
+        auto indexed = dictionary.find(word);
+        if (indexed == dictionary.end())
+        {
+            indexed = dictionary.emplace(word, 0).first;
+            indexed->second = AllocateWordId(indexed->first);
+        }
+        word_frequencies[indexed->second] += inv_word_count;
+    }
+
+    const vector<pair<int, double>> word_postings(word_frequencies.begin(), word_frequencies.end());
+    for (const auto& [word_id, frequency] : word_postings)
+    {
+        indexed_words[word_id].document_count++;
+        indexed_words[word_id].posting_count++;
+        terms.SetDocumentCount(word_id, indexed_words[word_id].document_count);
+    }
+    if (forward_index_enabled)
+    {
+        // One exactly sized array per document, already sorted by word id
+        pmr::vector<DocumentWord>& document_words = forward_index[document_id];
+        document_words.reserve(word_postings.size());
+        for (const auto& [word_id, frequency] : word_postings)
+        {
+            document_words.push_back({ word_id, static_cast<float>(frequency) });
+        }
+    }
+    buffer.AddDocument(document_id, status, rating, word_postings);
+
+    doc_rating_status[document_id] = { rating, status };
+    ids.insert(document_id);
+    METRIC_COUNT(MetricCounter::DOCUMENTS_ADDED, 1);
+
+    if (buffer.GetDocumentCount() >= SEGMENT_BUFFER_SIZE)
+    {
+        FreezeBuffer();
+        EnforceMemoryBudget();
+    }
+}
+void SearchServer::RemoveDocument(int document_id)
+{
+    METRIC_TIMER(MetricTimer::REMOVE_DOCUMENT);
+    unique_lock lock(index_mutex);
+    if (!ids.contains(document_id))
+        return;
+
+    // Everything, that may throw, is looked up before anything is changed, so a failed removal leaves the document whole
+    const DocumentStatus status = doc_rating_status.at(document_id).status;
+    // Word ids of the forward index lead straight to the counters of the words, no word is looked up by its text
+    vector<DocumentWord> posting_words;
+    const span<const DocumentWord> document_words = GetDocumentWords(document_id, posting_words);
+
+    METRIC_COUNT(MetricCounter::DOCUMENTS_REMOVED, 1);
+    for (const DocumentWord& word : document_words)
+    {
+        indexed_words[word.word_id].document_count--;
+        terms.SetDocumentCount(word.word_id, indexed_words[word.word_id].document_count);
+    }
+
+    if (buffer.ContainsDocument(document_id))
+    {
+        PurgedPostings purged;
+        buffer.RemoveDocument(document_id, status, document_words, purged);
+        PurgeDocument(document_id);
+        ReleasePurgedPostings(purged);
+    }
+    else
+    {
+        // Frozen buffers and sealed segments are immutable: the document is only marked as deleted, until a merge rewrites its segment
+        for (SegmentSlot& slot : segments)
+        {
+            if (slot.ContainsDocument(document_id) && !slot.deleted_ids.Contains(static_cast<uint32_t>(document_id)))
+            {
+                slot.deleted_ids.Add(static_cast<uint32_t>(document_id));
+                if (slot.HasTooManyDeleted())
+                    merge_condition.notify_one();
+                break;
+            }
+        }
+        PurgeDocument(document_id);
+    }
+    ids.erase(document_id);
+}
+void SearchServer::RemoveDocument(execution::sequenced_policy, int document_id)
+{
+    SearchServer::RemoveDocument(document_id);
+}
+void SearchServer::RemoveDocument(execution::parallel_policy, int document_id)
+{
+    // Removal only marks the document in its segment, there is nothing worth splitting between threads
+    SearchServer::RemoveDocument(document_id);
+}
+void SearchServer::RemoveDocument(AdaptivePolicy, int document_id)
+{
+    SearchServer::RemoveDocument(document_id);
+}
+void SearchServer::CompactRemovedDocuments()
+{
+    unique_lock lock(index_mutex);
+    // Buffer never holds removed documents, so only frozen buffers and sealed segments are rewritten
+    for (SegmentSlot& slot : segments)
+    {
+        if (slot.deleted_ids.IsEmpty())
+            continue;
+        if (!slot.segment)
+        {
+            slot.segment = make_shared<const SealedSegment>(*slot.frozen_buffer);
+            slot.frozen_buffer.reset();
+        }
+        PurgedPostings purged;
+        slot.segment = make_shared<const SealedSegment>(SealedSegment::Merge({ slot.segment }, { slot.deleted_ids }, purged));
+        slot.deleted_ids = RoaringBitmap();
+        ReleasePurgedPostings(purged);
+    }
+}
+
+vector<Document> SearchServer::FindTopDocuments(string_view raw_query, DocumentStatus status) const
+{
+    return FindTopDocuments(raw_query, DocumentFilter::ForStatus(status));
+} // Finds all matched documents (matching is determined by the status), then returns top ones (determine by MAX_RESULT_DOCUMENT_COUNT const)
+vector<Document> SearchServer::FindTopDocuments(execution::sequenced_policy, string_view raw_query, DocumentStatus status) const
+{
+    return FindTopDocuments(raw_query, status);
+} // Finds all matched documents (matching is determined by the status), then returns top ones (determine by MAX_RESULT_DOCUMENT_COUNT const)
+vector<Document> SearchServer::FindTopDocuments(execution::parallel_policy policy, string_view raw_query, DocumentStatus status) const
+{
+    return FindTopDocuments(policy, raw_query, DocumentFilter::ForStatus(status));
+} // Finds all matched documents (matching is determined by the status), then returns top ones (determine by MAX_RESULT_DOCUMENT_COUNT const)
+vector<Document> SearchServer::FindTopDocuments(AdaptivePolicy policy, string_view raw_query, DocumentStatus status) const
+{
+    return FindTopDocuments(policy, raw_query, DocumentFilter::ForStatus(status));
+} // Finds all matched documents (matching is determined by the status), then returns top ones (determine by MAX_RESULT_DOCUMENT_COUNT const)
+vector<Document> SearchServer::FindTopDocuments(QuantizedPolicy policy, string_view raw_query, DocumentStatus status) const
+{
+    return FindTopDocuments(policy, raw_query, DocumentFilter::ForStatus(status));
+} // Finds all matched documents (matching is determined by the status), then returns top ones by fixed point scores
+vector<Document> SearchServer::FindTopDocuments(string_view raw_query, const DocumentFilter& filter) const
+{
+    return FindTopDocuments(raw_query, filter, AcceptAllDocuments());
+} // Finds all matched documents (matching is determined by the filter only), then returns top ones (determine by MAX_RESULT_DOCUMENT_COUNT const)
+vector<Document> SearchServer::FindTopDocuments(execution::sequenced_policy, string_view raw_query, const DocumentFilter& filter) const
+{
+    return FindTopDocuments(raw_query, filter, AcceptAllDocuments());
+} // Finds all matched documents (matching is determined by the filter only), then returns top ones (determine by MAX_RESULT_DOCUMENT_COUNT const)
+vector<Document> SearchServer::FindTopDocuments(execution::parallel_policy policy, string_view raw_query, const DocumentFilter& filter) const
+{
+    return FindTopDocuments(policy, raw_query, filter, AcceptAllDocuments());
+} // Finds all matched documents (matching is determined by the filter only), then returns top ones (determine by MAX_RESULT_DOCUMENT_COUNT const)
+vector<Document> SearchServer::FindTopDocuments(AdaptivePolicy policy, string_view raw_query, const DocumentFilter& filter) const
+{
+    return FindTopDocuments(policy, raw_query, filter, AcceptAllDocuments());
+} // Finds all matched documents (matching is determined by the filter only), then returns top ones (determine by MAX_RESULT_DOCUMENT_COUNT const)
+vector<Document> SearchServer::FindTopDocuments(QuantizedPolicy policy, string_view raw_query, const DocumentFilter& filter) const
+{
+    return FindTopDocuments(policy, raw_query, filter, AcceptAllDocuments());
+} // Finds all matched documents (matching is determined by the filter only), then returns top ones by fixed point scores
+Task<TopDocumentsResult> SearchServer::FindTopDocumentsAsync(string raw_query, SearchDeadline::Clock::time_point deadline, stop_token stop_token) const
+{
+    return FindTopDocumentsAsync(move(raw_query), DocumentFilter::ForStatus(DocumentStatus::ACTUAL), deadline, move(stop_token));
+}
+Task<TopDocumentsResult> SearchServer::FindTopDocumentsAsync(string raw_query, DocumentFilter filter, SearchDeadline::Clock::time_point deadline, stop_token stop_token) const
+{
+    co_await executor.Schedule();
+    // Time, that the query has waited in the queue, counts against its deadline as well
+    SearchDeadline search_deadline(deadline, move(stop_token));
+    co_return FindTopDocumentsUntil(raw_query, filter, search_deadline);
+}
+
+tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(string_view raw_query, int document_id) const
+{
+    shared_lock lock(index_mutex);
+    if (!ids.contains(document_id))
+        return tuple(vector<string_view>(), doc_rating_status.at(document_id).status);
+
+    return MatchPreparedQuery(PrepareQuery(ParseQuery(raw_query)), document_id);
+}
+tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(execution::sequenced_policy, string_view raw_query, int document_id) const
+{
+    return SearchServer::MatchDocument(raw_query, document_id);
+}
+tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(execution::parallel_policy, string_view raw_query, int document_id) const
+{
+    // Matching a single document is one linear merge of two short arrays, splitting it between threads costs more than it saves
+    return SearchServer::MatchDocument(raw_query, document_id);
+}
+tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(AdaptivePolicy, string_view raw_query, int document_id) const
+{
+    return SearchServer::MatchDocument(raw_query, document_id);
+}
+vector<tuple<vector<string_view>, DocumentStatus>> SearchServer::MatchDocuments(string_view raw_query, const vector<int>& document_ids) const
+{
+    return SearchServer::MatchDocuments(execution::seq, raw_query, document_ids);
+}
+vector<tuple<vector<string_view>, DocumentStatus>> SearchServer::MatchDocuments(execution::sequenced_policy, string_view raw_query, const vector<int>& document_ids) const
+{
+    vector<tuple<vector<string_view>, DocumentStatus>> result;
+    result.reserve(document_ids.size());
+
+    shared_lock lock(index_mutex);
+    const PreparedQuery query = PrepareQuery(ParseQuery(raw_query));
+    for (int document_id : document_ids)
+    {
+        if (ids.contains(document_id))
+            result.push_back(MatchPreparedQuery(query, document_id));
+        else
+            result.push_back(tuple(vector<string_view>(), doc_rating_status.at(document_id).status));
+    }
+    return result;
+}
+vector<tuple<vector<string_view>, DocumentStatus>> SearchServer::MatchDocuments(execution::parallel_policy, string_view raw_query, const vector<int>& document_ids) const
+{
+    vector<tuple<vector<string_view>, DocumentStatus>> result(document_ids.size());
+
+    ExecutionCostModel::ParallelCallGuard parallel_call;
+    shared_lock lock(index_mutex);
+    const PreparedQuery query = PrepareQuery(ParseQuery(raw_query));
+    executor.ParallelFor
+    (
+        document_ids.size(),
+        [this, &query, &document_ids, &result](size_t i)
+        {
+            const int document_id = document_ids[i];
+            if (ids.contains(document_id))
+                result[i] = MatchPreparedQuery(query, document_id);
+            else
+                result[i] = tuple(vector<string_view>(), doc_rating_status.at(document_id).status);
+        }
+    );
+    return result;
+}
+vector<tuple<vector<string_view>, DocumentStatus>> SearchServer::MatchDocuments(AdaptivePolicy, string_view raw_query, const vector<int>& document_ids) const
+{
+    // Every document costs about one posting per query word: a lookup and a step of the merge
+    const size_t words_count = SplitIntoWords(raw_query).size();
+    if (cost_model.Plan(document_ids.size() * words_count).parallel)
+        return SearchServer::MatchDocuments(execution::par, raw_query, document_ids);
+    return SearchServer::MatchDocuments(execution::seq, raw_query, document_ids);
+}
+int SearchServer::GetDocumentCount() const
+{
+    shared_lock lock(index_mutex);
+    return static_cast<int>(ids.size());
+}
+vector<WordSuggestion> SearchServer::Suggest(string_view prefix, size_t max_count) const
+{
+    if (!IsValidWord(prefix))
+        throw invalid_argument("Prefix: " + static_cast<string>(prefix) + "; contains a special symbol.");
+
+    vector<WordSuggestion> suggestions;
+    shared_lock lock(index_mutex);
+    for (int word_id : terms.FindMostFrequent(prefix, max_count))
+    {
+        suggestions.push_back({ string(indexed_words[word_id].word), indexed_words[word_id].document_count });
+    }
+    return suggestions;
+}
+WordFrequencies SearchServer::GetWordFrequencies(int document_id) const
+{
+    WordFrequencies word_frequencies;
+    shared_lock lock(index_mutex);
+    //Tiny optimization
+    if (ids.count(document_id) == 0)
+        return word_frequencies;
+
+    vector<DocumentWord> posting_words;
+    for (const auto& [word_id, frequency] : GetDocumentWords(document_id, posting_words))
+    {
+        word_frequencies.emplace(indexed_words[word_id].word, frequency);
+    }
+    return word_frequencies;
+}
+vector<int> SearchServer::GetWordIds(int document_id) const
+{
+    vector<int> word_ids;
+    shared_lock lock(index_mutex);
+    if (ids.count(document_id) == 0)
+        return word_ids;
+
+    vector<DocumentWord> posting_words;
+    for (const DocumentWord& word : GetDocumentWords(document_id, posting_words))
+    {
+        word_ids.push_back(word.word_id);
+    }
+    return word_ids;
+}
+SearchServerMemoryStats SearchServer::GetMemoryStats() const
+{
+    shared_lock lock(index_mutex);
+    return CollectMemoryStats();
+}
+void SearchServer::SetMemoryBudget(size_t max_bytes)
+{
+    unique_lock lock(index_mutex);
+    memory_budget = max_bytes;
+    // Forward index is rebuilt only if it would fit, otherwise EnforceMemoryBudget would drop it right away
+    if (!forward_index_enabled && EstimateForwardIndexUsage().bytes <= memory_budget - min(memory_budget, CollectMemoryStats().GetTotal().bytes))
+        RebuildForwardIndex();
+    EnforceMemoryBudget();
+}
+bool SearchServer::HasForwardIndex() const
+{
+    shared_lock lock(index_mutex);
+    return forward_index_enabled;
+}
+ThreadPool& SearchServer::GetThreadPool() const
+{
+    return executor;
+}
+
+bool SearchServer::IsStopWord(string_view word) const
+{
+    return stop_words.count(word) > 0;
+} // check if it is a non relevant word
+SearchServer::Word SearchServer::ValidateWord(string_view word) const
+{
+    Word valid_word;
+    valid_word.word = word;
+    if (!IsValidWord(word))
+        throw invalid_argument("Word: " + static_cast<string>(word) + "; contains a special symbol.");
+    if (IsMinusWord(word))
+    {
+        valid_word.word.remove_prefix(1); // removes minus from the word
+        valid_word.status = WordStatus::Minus;
+        return valid_word;
+    }
+    valid_word.status = WordStatus::Plus;
+    return valid_word;
+}
+vector<string_view> SearchServer::SplitIntoWordsNoStop(string_view text) const
+{
+    vector<string_view> words;
+    for (const string_view& word : SplitIntoWords(text))
+    {
+        if (!IsStopWord(word))
+            words.push_back(word);
+    }
+    return words;
+} // Parse text, excluding non important words
+SearchServer::Query SearchServer::ParseQuery(string_view text) const
+{
+    METRIC_TIMER(MetricTimer::QUERY_PARSE);
+    Query query;
+    for (string_view& word : SplitIntoWords(text))
+    {
+        Word valid_word = ValidateWord(word);
+        if (IsStopWord(valid_word.word))
+            continue;
+
+        const bool is_plus = valid_word.status == WordStatus::Plus;
+        vector<string_view>& words = is_plus ? query.plus_words : query.minus_words;
+        const size_t first_word = words.size();
+        if (IsPrefixWord(valid_word.word))
+            ExpandPrefix(valid_word.word, words);
+        else if (IsFuzzyWord(valid_word.word))
+        {
+            for (const auto& [fuzzy_word, weight] : FindFuzzyWords(valid_word.word))
+            {
+                if (is_plus && weight < 1.0)
+                {
+                    query.fuzzy_words.push_back({ fuzzy_word, weight });
+                    query.plus_word_sources.push_back({ fuzzy_word, valid_word.word });
+                }
+                else
+                    words.push_back(fuzzy_word); // Minus words exclude typos as well, and exact match is an ordinary plus word
+            }
+        }
+        else
+            words.push_back(valid_word.word);
+        for (size_t i = first_word; is_plus && i < words.size(); i++)
+        {
+            query.plus_word_sources.push_back({ words[i], valid_word.word });
+        }
+    }
+
+    // Word, that is in the raw query itself, is its own source, even if some "prefix*" or "word~" is expanded into it as well
+    sort(query.plus_word_sources.begin(), query.plus_word_sources.end(), [](const auto& lhs, const auto& rhs)
+        {
+            return lhs.first < rhs.first || (lhs.first == rhs.first && (lhs.first == lhs.second) > (rhs.first == rhs.second));
+        });
+    query.plus_word_sources.erase(unique(query.plus_word_sources.begin(), query.plus_word_sources.end(), [](const auto& lhs, const auto& rhs) { return lhs.first == rhs.first; }), query.plus_word_sources.end());
+    sort(query.plus_words.begin(), query.plus_words.end());
+    query.plus_words.erase(unique(query.plus_words.begin(), query.plus_words.end()), query.plus_words.end());
+    sort(query.minus_words.begin(), query.minus_words.end());
+    query.minus_words.erase(unique(query.minus_words.begin(), query.minus_words.end()), query.minus_words.end());
+
+    // Word keeps the largest weight it got, and the words of the query itself are not down-weighted for being a typo of another one
+    sort(query.fuzzy_words.begin(), query.fuzzy_words.end(), [](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first || (lhs.first == rhs.first && lhs.second > rhs.second); });
+    query.fuzzy_words.erase(unique(query.fuzzy_words.begin(), query.fuzzy_words.end(), [](const auto& lhs, const auto& rhs) { return lhs.first == rhs.first; }), query.fuzzy_words.end());
+    erase_if(query.fuzzy_words, [&query](const auto& word) { return binary_search(query.plus_words.begin(), query.plus_words.end(), word.first); });
+
+
+    return query;
+}
+SearchServer::Query SearchServer::ParseQuery(execution::sequenced_policy, string_view text) const
+{
+    return SearchServer::ParseQuery(text);
+}
+void SearchServer::ExpandPrefix(string_view prefix_word, vector<string_view>& words) const
+{
+    prefix_word.remove_suffix(1);
+    // Expanded words point into the dictionary, they are valid only under the lock
+    for (int word_id : terms.FindMostFrequent(prefix_word, MAX_PREFIX_EXPANSION))
+    {
+        words.push_back(indexed_words[word_id].word);
+    }
+} // Minus prefix excludes the same capped set of words
+vector<pair<string_view, double>> SearchServer::FindFuzzyWords(string_view fuzzy_word) const
+{
+    int max_edits = 0;
+    if (fuzzy_word.back() == '~')
+    {
+        fuzzy_word.remove_suffix(1);
+        max_edits = fuzzy_word.size() < 3 ? 0 : fuzzy_word.size() < 6 ? 1 : 2; // Short words have too many neighbours
+    }
+    else
+    {
+        max_edits = fuzzy_word.back() - '0';
+        fuzzy_word.remove_suffix(2);
+        if (max_edits > MAX_FUZZY_EDITS)
+            throw invalid_argument("Word: " + static_cast<string>(fuzzy_word) + "; tolerates at most " + to_string(MAX_FUZZY_EDITS) + " edits.");
+    }
+
+    struct FuzzyMatch
+    {
+        int word_id;
+        int edits;
+        int document_count;
+    };
+    vector<FuzzyMatch> matches;
+    // Closer words always win, so farther ones are not even looked for, once the expansion is full. Walk of a larger
+    // distance visits many times more nodes, so repeating the smaller ones costs little
+    for (int edits = 0; edits <= max_edits && matches.size() < MAX_FUZZY_EXPANSION; edits++)
+    {
+        LevenshteinAutomaton automaton(fuzzy_word, edits);
+        terms.Intersect(automaton, [&](int word_id, int document_count, size_t depth)
+            {
+                if (automaton.GetDistance(depth) == edits)
+                    matches.push_back({ word_id, edits, document_count });
+            });
+    }
+
+    const size_t count = min(matches.size(), MAX_FUZZY_EXPANSION);
+    partial_sort(matches.begin(), matches.begin() + count, matches.end(), [](const FuzzyMatch& lhs, const FuzzyMatch& rhs)
+        {
+            return lhs.edits < rhs.edits || (lhs.edits == rhs.edits && lhs.document_count > rhs.document_count);
+        });
+    vector<pair<string_view, double>> words;
+    for (size_t i = 0; i < count; i++)
+    {
+        words.push_back({ indexed_words[matches[i].word_id].word, pow(FUZZY_EDIT_WEIGHT, matches[i].edits) });
+    }
+    return words;
+}
+
+double SearchServer::CalculateIDF(const IndexedWord& word) const
+{
+    double relevance = log(static_cast<int>(ids.size()) / static_cast<double>(word.document_count));
+
+    return relevance;
+} // Inverse Document Frequency for word
+
+int SearchServer::AllocateWordId(string_view word)
+{
+    int word_id = static_cast<int>(indexed_words.size());
+    if (free_word_ids.empty())
+        indexed_words.push_back({ word });
+    else
+    {
+        word_id = free_word_ids.back();
+        free_word_ids.pop_back();
+        indexed_words[word_id] = { word };
+    }
+    terms.Insert(word, word_id);
+    return word_id;
+}
+void SearchServer::ReleasePurgedPostings(const PurgedPostings& purged)
+{
+    for (const auto& [word_id, posting_count] : purged)
+    {
+        IndexedWord& indexed = indexed_words[word_id];
+        indexed.posting_count -= posting_count;
+        if (indexed.posting_count > 0)
+            continue;
+
+        // No segment refers to the word anymore, so its id can be given to a new word
+        terms.Erase(word_id);
+        dictionary.erase(dictionary.find(indexed.word));
+        indexed = IndexedWord();
+        free_word_ids.push_back(word_id);
+    }
+}
+void SearchServer::PurgeDocument(int document_id)
+{
+    forward_index.erase(document_id);
+    documents.erase(document_id);
+    doc_rating_status.erase(document_id);
+} // Postings are left to the segment, the document is marked as deleted in
+SearchServer::PreparedQuery SearchServer::PrepareQuery(const Query& query) const
+{
+    // Matched words point into the raw query, as the dictionary may drop its words, once the lock is released
+    const auto find_source = [&query](string_view word)
+    {
+        return lower_bound(query.plus_word_sources.begin(), query.plus_word_sources.end(), word, [](const auto& source, string_view word) { return source.first < word; })->second;
+    };
+    PreparedQuery prepared;
+    for (string_view word : query.plus_words)
+    {
+        const auto known = dictionary.find(word);
+        if (known != dictionary.end())
+            prepared.plus_words.push_back({ known->second, find_source(word) });
+    }
+    for (const auto& [word, weight] : query.fuzzy_words)
+    {
+        const auto known = dictionary.find(word);
+        if (known != dictionary.end())
+            prepared.plus_words.push_back({ known->second, find_source(word) });
+    }
+    for (string_view word : query.minus_words)
+    {
+        const auto known = dictionary.find(word);
+        if (known != dictionary.end())
+            prepared.minus_word_ids.push_back(known->second);
+    }
+
+    sort(prepared.plus_words.begin(), prepared.plus_words.end());
+    prepared.plus_words.erase(unique(prepared.plus_words.begin(), prepared.plus_words.end()), prepared.plus_words.end());
+    sort(prepared.minus_word_ids.begin(), prepared.minus_word_ids.end());
+
+    return prepared;
+}
+SearchServer::SegmentQuery SearchServer::ResolveQuery(const Query& query) const
+{
+    // Words, that are left only in removed documents, can't match anything
+    SegmentQuery resolved;
+    for (string_view word : query.plus_words)
+    {
+        const auto known = dictionary.find(word);
+        if (known != dictionary.end() && indexed_words[known->second].document_count > 0)
+            resolved.plus_words.push_back({ known->second, CalculateIDF(indexed_words[known->second]) });
+    }
+    for (const auto& [word, weight] : query.fuzzy_words)
+    {
+        const auto known = dictionary.find(word);
+        if (known != dictionary.end() && indexed_words[known->second].document_count > 0)
+            resolved.plus_words.push_back({ known->second, CalculateIDF(indexed_words[known->second]) * weight });
+    }
+    for (string_view word : query.minus_words)
+    {
+        const auto known = dictionary.find(word);
+        if (known != dictionary.end() && indexed_words[known->second].document_count > 0)
+            resolved.minus_word_ids.push_back(known->second);
+    }
+    return resolved;
+}
+tuple<vector<string_view>, DocumentStatus> SearchServer::MatchPreparedQuery(const PreparedQuery& query, int document_id) const
+{
+    vector<string_view> matched_words;
+    const DocumentStatus status = doc_rating_status.at(document_id).status;
+    vector<DocumentWord> posting_words;
+    span<const DocumentWord> document_words;
+    if (forward_index_enabled)
+        document_words = forward_index.at(document_id);
+    else
+    {
+        posting_words = FindQueryWords(query, document_id);
+        document_words = posting_words;
+    }
+
+    // Both sides are sorted by word id, so every check is a single linear merge
+    auto document_word = document_words.begin();
+    for (int minus_word_id : query.minus_word_ids)
+    {
+        document_word = lower_bound(document_word, document_words.end(), minus_word_id, [](const DocumentWord& word, int word_id) { return word.word_id < word_id; });
+        if (document_word == document_words.end())
+            break;
+        if (document_word->word_id == minus_word_id)
+            return tuple(matched_words, status);
+    }
+
+    document_word = document_words.begin();
+    auto plus_word = query.plus_words.begin();
+    while (document_word != document_words.end() && plus_word != query.plus_words.end())
+    {
+        if (document_word->word_id < plus_word->first)
+            ++document_word;
+        else if (plus_word->first < document_word->word_id)
+            ++plus_word;
+        else
+        {
+            matched_words.push_back(plus_word->second);
+            ++document_word;
+            ++plus_word;
+        }
+    }
+
+    sort(matched_words.begin(), matched_words.end()); // Same order as the words of the query
+    matched_words.erase(unique(matched_words.begin(), matched_words.end()), matched_words.end()); // Several words may come from one "prefix*"
+    return tuple(matched_words, status);
+}
+vector<DocumentWord> SearchServer::FindQueryWords(const PreparedQuery& query, int document_id) const
+{
+    // Only the postings of the query words are searched, which is a binary search per word instead of a scan of the whole segment
+    vector<DocumentWord> words;
+    const size_t status = static_cast<size_t>(doc_rating_status.at(document_id).status);
+    VisitDocumentSegment(document_id, [&](const auto& segment)
+        {
+            const auto check_word = [&](int word_id)
+            {
+                const Posting* posting = FindPosting(segment.FindWord(word_id)[status].postings, document_id);
+                if (posting != nullptr)
+                    words.push_back({ word_id, posting->term_frequency });
+            };
+            for (const auto& [word_id, word] : query.plus_words)
+            {
+                check_word(word_id);
+            }
+            for (int word_id : query.minus_word_ids)
+            {
+                check_word(word_id);
+            }
+        });
+    const auto lower_word_id = [](const DocumentWord& lhs, const DocumentWord& rhs) { return lhs.word_id < rhs.word_id; };
+    const auto same_word_id = [](const DocumentWord& lhs, const DocumentWord& rhs) { return lhs.word_id == rhs.word_id; };
+    sort(words.begin(), words.end(), lower_word_id);
+    words.erase(unique(words.begin(), words.end(), same_word_id), words.end());
+    return words;
+}
+vector<DocumentWord> SearchServer::FindDocumentWords(int document_id) const
+{
+    vector<DocumentWord> words;
+    const DocumentStatus status = doc_rating_status.at(document_id).status;
+    VisitDocumentSegment(document_id, [&](const auto& segment)
+        {
+            words = segment.FindDocumentWords(document_id, status);
+        });
+    return words;
+}
+span<const DocumentWord> SearchServer::GetDocumentWords(int document_id, vector<DocumentWord>& posting_words) const
+{
+    if (forward_index_enabled)
+        return forward_index.at(document_id);
+    posting_words = FindDocumentWords(document_id);
+    return posting_words;
+}
+
+void SearchServer::AppendTopDocuments(const map<int, double>& docs_id, vector<Document>& result) const
+{
+    // Rating only breaks ties, so it is looked up just for the documents within EPSILON of the last one, that makes the top
+    double min_relevance = numeric_limits<double>::lowest();
+    if (docs_id.size() > MAX_RESULT_DOCUMENT_COUNT)
+    {
+        vector<double> relevances;
+        relevances.reserve(docs_id.size());
+        for (const auto& [id, relevance] : docs_id)
+        {
+            relevances.push_back(relevance);
+        }
+        nth_element(relevances.begin(), relevances.begin() + (MAX_RESULT_DOCUMENT_COUNT - 1), relevances.end(), greater<double>());
+        min_relevance = relevances[MAX_RESULT_DOCUMENT_COUNT - 1] - EPSILON;
+    }
+    const size_t begin = result.size();
+    for (const auto& [id, relevance] : docs_id)
+    {
+        if (relevance >= min_relevance)
+            result.push_back({ id, relevance, doc_rating_status.at(id).rating });
+    }
+    if (result.size() - begin > MAX_RESULT_DOCUMENT_COUNT)
+    {
+        partial_sort(result.begin() + begin, result.begin() + begin + MAX_RESULT_DOCUMENT_COUNT, result.end(), IsMoreRelevant);
+        result.resize(begin + MAX_RESULT_DOCUMENT_COUNT);
+    }
+}
+
+TopDocumentsResult SearchServer::FindTopDocumentsUntil(string_view raw_query, const DocumentFilter& filter, SearchDeadline& deadline) const
+{
+    METRIC_COUNT(MetricCounter::QUERIES, 1);
+    TopDocumentsResult result;
+    shared_lock lock(index_mutex);
+    // exeptions are handled inside of ParseQuery() function
+    result.documents = FindAllDocuments(ResolveQuery(ParseQuery(raw_query)), filter, AcceptAllDocuments(), &deadline);
+    lock.unlock();
+
+    result.truncated = deadline.WasReached();
+    if (result.truncated)
+        METRIC_COUNT(MetricCounter::QUERIES_TRUNCATED, 1);
+    METRIC_TIMER(MetricTimer::TOP_K_SELECTION);
+    sort(result.documents.begin(), result.documents.end(), IsMoreRelevant);
+    if (result.documents.size() > MAX_RESULT_DOCUMENT_COUNT)
+        result.documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+    return result;
+}
+vector<DocumentSnippet> SearchServer::FindTopDocumentsWithSnippets(string_view raw_query, DocumentStatus status) const
+{
+    return FindTopDocumentsWithSnippets(raw_query, DocumentFilter::ForStatus(status));
+}
+vector<DocumentSnippet> SearchServer::FindTopDocumentsWithSnippets(string_view raw_query, const DocumentFilter& filter) const
+{
+    METRIC_COUNT(MetricCounter::QUERIES, 1);
+    // Lock is held, until the snippets are cut, as they point into the stored text
+    shared_lock lock(index_mutex);
+    // exeptions are handled inside of ParseQuery() function
+    const SegmentQuery query = ResolveQuery(ParseQuery(raw_query));
+    vector<Document> matched_documents = FindAllDocuments(query, filter, AcceptAllDocuments());
+    {
+        METRIC_TIMER(MetricTimer::TOP_K_SELECTION);
+        sort(matched_documents.begin(), matched_documents.end(), IsMoreRelevant);
+        if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT)
+            matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+    }
+
+    METRIC_TIMER(MetricTimer::SNIPPET_GENERATION);
+    // Words and weights, that the documents were scored by, expansions of prefix and fuzzy words included
+    vector<pair<string_view, double>> query_words;
+    for (const auto& [word_id, idf] : query.plus_words)
+    {
+        query_words.push_back({ indexed_words[word_id].word, idf });
+    }
+    sort(query_words.begin(), query_words.end(), [](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first || (lhs.first == rhs.first && lhs.second > rhs.second); });
+    query_words.erase(unique(query_words.begin(), query_words.end(), [](const auto& lhs, const auto& rhs) { return lhs.first == rhs.first; }), query_words.end());
+
+    vector<DocumentSnippet> result;
+    result.reserve(matched_documents.size());
+    for (const Document& document : matched_documents)
+    {
+        result.push_back(MakeSnippet(document, query_words));
+    }
+    return result;
+}
+DocumentSnippet SearchServer::MakeSnippet(const Document& document, const vector<pair<string_view, double>>& query_words) const
+{
+    DocumentSnippet snippet{ document, {}, {} };
+    const string_view text = documents.at(document.id);
+    const vector<string_view> words = SplitIntoWords(text);
+    if (words.empty())
+        return snippet;
+    vector<int> matches(words.size(), -1); // [word of the text] -> index in query_words
+    for (size_t i = 0; i < words.size(); i++)
+    {
+        const auto query_word = lower_bound(query_words.begin(), query_words.end(), words[i], [](const auto& lhs, string_view rhs) { return lhs.first < rhs; });
+        if (query_word != query_words.end() && query_word->first == words[i])
+            matches[i] = static_cast<int>(query_word - query_words.begin());
+    }
+
+    // Window slides over the words once. It is scored by the weight of the distinct query words in it, so a window with
+    // several of them beats the one, that repeats a single word
+    const size_t window = min(SNIPPET_WORD_COUNT, words.size());
+    vector<int> counts(query_words.size(), 0);
+    double score = 0.0;
+    double best_score = 0.0;
+    size_t best_begin = 0;
+    for (size_t end = 0; end < words.size(); end++)
+    {
+        if (matches[end] >= 0 && counts[matches[end]]++ == 0)
+            score += query_words[matches[end]].second;
+        if (end >= window && matches[end - window] >= 0 && --counts[matches[end - window]] == 0)
+            score -= query_words[matches[end - window]].second;
+        if (end + 1 >= window && score > best_score + EPSILON)
+        {
+            best_score = score;
+            best_begin = end + 1 - window;
+        }
+    }
+
+    // The first best window ends with a query word; it is moved to put the matched words into the middle, still covering all of them
+    size_t first_match = best_begin + window;
+    size_t last_match = best_begin;
+    for (size_t i = best_begin; i < best_begin + window; i++)
+    {
+        if (matches[i] >= 0)
+        {
+            first_match = min(first_match, i);
+            last_match = i;
+        }
+    }
+    if (first_match <= last_match)
+    {
+        const size_t slack = window - (last_match - first_match + 1);
+        best_begin = min(first_match - min(first_match, slack / 2), words.size() - window);
+    }
+
+    const string_view first_word = words[best_begin];
+    const string_view last_word = words[best_begin + window - 1];
+    snippet.text = text.substr(first_word.data() - text.data(), last_word.data() + last_word.size() - first_word.data());
+    for (size_t i = best_begin; i < best_begin + window; i++)
+    {
+        if (matches[i] >= 0)
+        {
+            const size_t begin = words[i].data() - snippet.text.data();
+            snippet.highlights.push_back({ begin, begin + words[i].size() });
+        }
+    }
+    return snippet;
+} // Document has to be alive
+
+size_t SearchServer::CountQueryPostings(const SegmentQuery& query, const DocumentFilter& filter) const
+{
+    size_t postings_count = 0;
+    ForEachSegment([&](const auto& segment, const RoaringBitmap& /*deleted_ids*/)
+        {
+            const auto count_word = [&](int word_id)
+            {
+                const WordPartitions partitions = segment.FindWord(word_id);
+                for (size_t status = 0; status < DOCUMENT_STATUS_COUNT; status++)
+                {
+                    if (IsPartitionAccepted(filter, status, partitions[status]))
+                        postings_count += partitions[status].postings.size();
+                }
+            };
+            for (const auto& [word_id, relevance] : query.plus_words)
+            {
+                count_word(word_id);
+            }
+            for (int word_id : query.minus_word_ids)
+            {
+                count_word(word_id);
+            }
+        });
+    return postings_count;
+}
+bool SearchServer::IsPartitionAccepted(const DocumentFilter& filter, size_t status, const PostingPartition& partition)
+{
+    return !partition.postings.empty()
+        && filter.AcceptsStatus(static_cast<DocumentStatus>(status))
+        && filter.AcceptsAnyRating(partition.min_rating, partition.max_rating);
+} // Whole partition is skipped, if none of its documents can pass the filter
+bool SearchServer::IsMoreRelevant(const Document& lhs, const Document& rhs)
+{
+    return lhs.relevance > rhs.relevance || (abs(lhs.relevance - rhs.relevance) <= EPSILON && lhs.rating > rhs.rating);
+}
+
+bool SearchServer::SegmentSlot::ContainsDocument(int document_id) const
+{
+    return segment ? segment->ContainsDocument(document_id) : frozen_buffer->ContainsDocument(document_id);
+}
+size_t SearchServer::SegmentSlot::GetDocumentCount() const
+{
+    return segment ? segment->GetDocumentCount() : frozen_buffer->GetDocumentCount();
+}
+bool SearchServer::SegmentSlot::HasTooManyDeleted() const
+{
+    const size_t deleted_count = deleted_ids.GetCardinality();
+    return segment && deleted_count >= COMPACTION_BATCH_SIZE && deleted_count >= segment->GetDocumentCount() * SEGMENT_DELETED_SHARE;
+}
+
+SearchServerMemoryStats SearchServer::CollectMemoryStats() const
+{
+    SearchServerMemoryStats stats;
+    stats.documents = documents_memory.GetUsage();
+    stats.forward_index = forward_index_memory.GetUsage();
+    stats.dictionary = dictionary_memory.GetUsage();
+    stats.stop_words = stop_words_memory.GetUsage();
+    stats.doc_rating_status = doc_rating_status_memory.GetUsage();
+    stats.ids = ids_memory.GetUsage();
+
+    stats.segments = buffer.GetMemoryUsage();
+    stats.segments += { segments.capacity() * sizeof(SegmentSlot), segments.capacity() > 0 ? size_t(1) : size_t(0) };
+    for (const SegmentSlot& slot : segments)
+    {
+        stats.segments += slot.segment ? slot.segment->GetMemoryUsage() : slot.frozen_buffer->GetMemoryUsage();
+        stats.segments += { slot.deleted_ids.GetMemoryUsage(), 0 };
+    }
+    return stats;
+}
+MemoryUsage SearchServer::EstimateForwardIndexUsage() const
+{
+    const size_t NODE_OVERHEAD = 4 * sizeof(void*); // Color and links of the tree node
+    // Live document of a word is one entry of the forward index
+    size_t entry_count = 0;
+    for (const IndexedWord& word : indexed_words)
+    {
+        entry_count += word.document_count;
+    }
+    return { entry_count * sizeof(DocumentWord) + ids.size() * (sizeof(pair<const int, pmr::vector<DocumentWord>>) + NODE_OVERHEAD), 2 * ids.size() };
+} // Upper bound: vectors are exactly sized, and the ones of stop word documents allocate nothing
+void SearchServer::EnforceMemoryBudget()
+{
+    if (!forward_index_enabled || memory_budget == UNLIMITED_MEMORY_BUDGET)
+        return;
+    if (CollectMemoryStats().GetTotal().bytes <= memory_budget)
+        return;
+
+    // Postings hold the same words and frequencies, so only the fast paths of MatchDocument and RemoveDocument are lost
+    forward_index.clear();
+    forward_index_enabled = false;
+}
+void SearchServer::RebuildForwardIndex()
+{
+    forward_index.clear();
+    // Document of stop words only has no postings, but it still has its (empty) entry, as every live document does
+    for (int document_id : ids)
+    {
+        forward_index.try_emplace(forward_index.end(), document_id);
+    }
+    // Every posting is visited in the order of word ids, so words of every document come out sorted
+    ForEachSegment([this](const auto& segment, const RoaringBitmap& deleted_ids)
+        {
+            segment.ForEachPosting([&](int word_id, const Posting& posting)
+                {
+                    if (!deleted_ids.Contains(static_cast<uint32_t>(posting.document_id)))
+                        forward_index.at(posting.document_id).push_back({ word_id, posting.term_frequency });
+                });
+        });
+    for (auto& [document_id, document_words] : forward_index)
+    {
+        document_words.shrink_to_fit();
+    }
+    forward_index_enabled = true;
+}
+void SearchServer::FreezeBuffer()
+{
+    // Only the buffer itself is moved here, sealing and freeing its postings is left to the background thread
+    segments.push_back({ make_shared<const SegmentBuffer>(move(buffer)), nullptr, RoaringBitmap() });
+    buffer = SegmentBuffer();
+
+    if (!merger.joinable())
+        merger = jthread([this](stop_token stop_token) { MergeLoop(stop_token); });
+    merge_condition.notify_one();
+}
+bool SearchServer::HasFrozenBuffer() const
+{
+    return any_of(segments.begin(), segments.end(), [](const SegmentSlot& slot) { return !slot.segment; });
+}
+vector<size_t> SearchServer::SelectMergeSegments() const
+{
+    // Tiered policy: segments of similar size are merged together, so every posting is rewritten only about log(N) times.
+    // Tier of a segment is log by SEGMENT_MERGE_FACTOR of its size in sealed buffers
+    map<size_t, vector<size_t>> tiers; // [tier, segment indexes]
+    for (size_t index = 0; index < segments.size(); index++)
+    {
+        if (!segments[index].segment)
+            continue;
+        size_t tier = 0;
+        for (size_t size = SEGMENT_BUFFER_SIZE * SEGMENT_MERGE_FACTOR; segments[index].segment->GetDocumentCount() >= size; size *= SEGMENT_MERGE_FACTOR)
+        {
+            tier++;
+        }
+        vector<size_t>& tier_segments = tiers[tier];
+        tier_segments.push_back(index);
+        if (tier_segments.size() == SEGMENT_MERGE_FACTOR)
+            return tier_segments;
+    }
+
+    // Segment, that is not due for a merge, but has a lot of removed documents, is rewritten alone
+    for (size_t index = 0; index < segments.size(); index++)
+    {
+        if (segments[index].HasTooManyDeleted())
+            return { index };
+    }
+    return {};
+}
+void SearchServer::ReplaceSegments(const vector<shared_ptr<const SealedSegment>>& merged_segments, const vector<RoaringBitmap>& merged_deleted_ids,
+    shared_ptr<const SealedSegment> segment, const PurgedPostings& purged)
+{
+    vector<size_t> indexes;
+    for (const shared_ptr<const SealedSegment>& merged_segment : merged_segments)
+    {
+        const auto slot = find_if(segments.begin(), segments.end(), [&merged_segment](const SegmentSlot& slot) { return slot.segment == merged_segment; });
+        if (slot == segments.end())
+            return; // Segment was rewritten by CompactRemovedDocuments meanwhile, so this merge is out of date
+        indexes.push_back(slot - segments.begin());
+    }
+
+    // Documents, removed while the merge was running, are still in the merged segment
+    RoaringBitmap deleted_ids;
+    for (size_t i = 0; i < indexes.size(); i++)
+    {
+        deleted_ids = deleted_ids | AndNot(segments[indexes[i]].deleted_ids, merged_deleted_ids[i]);
+    }
+
+    sort(indexes.begin(), indexes.end(), greater<size_t>());
+    for (size_t index : indexes)
+    {
+        segments.erase(segments.begin() + index);
+    }
+    segments.push_back({ nullptr, move(segment), move(deleted_ids) });
+    ReleasePurgedPostings(purged);
+}
+void SearchServer::MergeLoop(stop_token stop_token)
+{
+    while (!stop_token.stop_requested())
+    {
+        unique_lock lock(index_mutex);
+        vector<size_t> selected;
+        const bool has_work = merge_condition.wait(lock, stop_token, [this, &selected]()
+            {
+                selected = SelectMergeSegments();
+                return HasFrozenBuffer() || !selected.empty();
+            });
+        if (!has_work)
+            continue;
+
+        // Frozen buffers and sealed segments are immutable, so they are processed without the lock, while queries and modifications go on.
+        // Lock is released again, before the local copies are destroyed, so the memory of replaced segments is freed outside of it too
+        const auto frozen = find_if(segments.begin(), segments.end(), [](const SegmentSlot& slot) { return !slot.segment; });
+        if (frozen != segments.end())
+        {
+            // Buffer is sealed as it is: its removed documents stay marked in deleted_ids, until the segment is merged
+            const shared_ptr<const SegmentBuffer> frozen_buffer = frozen->frozen_buffer;
+            lock.unlock();
+            shared_ptr<const SealedSegment> segment;
+            {
+                METRIC_TIMER(MetricTimer::SEGMENT_SEAL);
+                segment = make_shared<const SealedSegment>(*frozen_buffer);
+            }
+            lock.lock();
+            const auto slot = find_if(segments.begin(), segments.end(), [&frozen_buffer](const SegmentSlot& slot) { return slot.frozen_buffer == frozen_buffer; });
+            if (slot != segments.end())
+            {
+                slot->segment = move(segment);
+                slot->frozen_buffer.reset();
+            }
+            lock.unlock();
+            continue;
+        }
+
+        vector<shared_ptr<const SealedSegment>> merged_segments;
+        vector<RoaringBitmap> merged_deleted_ids;
+        for (size_t index : selected)
+        {
+            merged_segments.push_back(segments[index].segment);
+            merged_deleted_ids.push_back(segments[index].deleted_ids);
+        }
+        lock.unlock();
+        PurgedPostings purged;
+        shared_ptr<const SealedSegment> segment;
+        {
+            METRIC_TIMER(MetricTimer::SEGMENT_MERGE);
+            segment = make_shared<const SealedSegment>(SealedSegment::Merge(merged_segments, merged_deleted_ids, purged));
+        }
+        lock.lock();
+        ReplaceSegments(merged_segments, merged_deleted_ids, move(segment), purged);
+        lock.unlock();
+    }
+} // Runs in the background, sealing frozen buffers, merging sealed segments and purging removed documents
\ No newline at end of file
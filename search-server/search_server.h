@@ -1,280 +1,789 @@
-#pragma once
-
-#include <vector>
-#include <set>
-#include <map>
-#include <string>
-#include <cmath>
-#include <algorithm>
-#include <numeric>
-#include <stdexcept>
-#include <execution>
-
-#include "document.h"
-#include "string_processing.h"
-#include "concurrent_map.h"
-
-const double EPSILON = 1e-6;
-const int MAX_RESULT_DOCUMENT_COUNT = 5;
-
-bool IsValidWord(std::string_view word);
-bool IsCorrectMinus(std::string_view word);
-bool IsMinusWord(std::string_view word);
-int ComputeIntegerAverage(const std::vector<int>& values);
-
-class SearchServer
-{
-public:
-#pragma region Constructors
-    SearchServer() = default;
-    template<template<typename...> typename Container>
-    explicit SearchServer(Container<std::string> stop_words_to_add);
-    template<template<typename...> typename Container>
-    explicit SearchServer(Container<std::string_view> stop_words_to_add);
-    //explicit SearchServer(const std::string_view& stop_words_text) : SearchServer(SplitIntoWords(stop_words_text)) {} -> For some reason, this one tries to call itself, but next one is working
-    explicit SearchServer(std::string_view stop_words_text)
-    {
-        for (const std::string_view& word : SplitIntoWords(stop_words_text))
-        {
-            if (!word.empty())
-            {
-                if (IsValidWord(word))
-                    stop_words.insert(static_cast<std::string>(word));
-                else
-                    throw std::invalid_argument("Word: " + static_cast<std::string>(word) + "; contains a special symbol.");
-            }
-        }
-    }
-#pragma endregion
-    void AddDocument(int document_id, std::string_view text_document, DocumentStatus status, const std::vector<int>& ratings);
-    void RemoveDocument(int document_id);
-    void RemoveDocument(std::execution::sequenced_policy policy, int document_id);
-    void RemoveDocument(std::execution::parallel_policy policy, int document_id);
-
-    template <typename SortingFunction>
-    std::vector<Document> FindTopDocuments(std::string_view raw_query, SortingFunction func) const;
-    template <typename SortingFunction>
-    std::vector<Document> FindTopDocuments(std::execution::sequenced_policy, std::string_view raw_query, SortingFunction func) const;
-    template <typename SortingFunction>
-    std::vector<Document> FindTopDocuments(std::execution::parallel_policy, std::string_view raw_query, SortingFunction func) const;
-
-    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status = DocumentStatus::ACTUAL) const;
-    std::vector<Document> FindTopDocuments(std::execution::sequenced_policy, std::string_view raw_query, DocumentStatus status = DocumentStatus::ACTUAL) const;
-    std::vector<Document> FindTopDocuments(std::execution::parallel_policy, std::string_view raw_query, DocumentStatus status = DocumentStatus::ACTUAL) const;
-
-    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::string_view raw_query, int document_id) const;
-    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::execution::sequenced_policy policy, std::string_view raw_query, int document_id) const;
-    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::execution::parallel_policy policy, std::string_view raw_query, int document_id) const;
-
-    int GetDocumentCount() const;
-    const std::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
-    auto begin()
-    {
-        return ids.begin();
-    }
-    auto end()
-    {
-        return ids.end();
-    }
-private:
-    struct Rating_Status
-    {
-        int rating;
-        DocumentStatus status;
-    };
-    std::map<int, std::string> documents;
-    std::map<int, std::map<std::string_view, double>> document_word_frequencies;
-    std::map<std::string_view, std::map<int, double>> word_to_document_freqs;
-    std::set<std::string, std::less<>> stop_words;
-    std::map<int, Rating_Status> doc_rating_status;
-    std::set<int> ids;
-
-    struct Query
-    {
-        std::vector<std::string_view> plus_words;
-        std::vector<std::string_view> minus_words;
-    };
-    enum class WordStatus
-    {
-        Plus = 0,
-        Minus = 1
-    };
-    struct Word
-    {
-        std::string_view word;
-        WordStatus status;
-    };
-
-    bool IsStopWord(std::string_view word) const; // check if it is a non relevant word
-
-    Word ValidateWord(std::string_view word) const;
-    std::vector<std::string_view> SplitIntoWordsNoStop(std::string_view text) const; // Parse text, excluding non important words
-
-    Query ParseQuery(std::string_view text) const; // Returns 2 sets of plus and minus words separatly (in that order)
-    Query ParseQuery(std::execution::sequenced_policy policy, std::string_view text) const;
-    Query ParseQuery(std::execution::parallel_policy policy, std::string_view text) const;
-
-    double CalculateIDF(std::string_view word) const; // Inverse Document Frequency for word
-
-    template <typename SortingFunction>
-    std::vector<Document> FindAllDocuments(Query query, SortingFunction func) const;
-    template <typename SortingFunction>
-    std::vector<Document> FindAllDocuments(std::execution::sequenced_policy, Query query, SortingFunction func) const;
-    template <typename SortingFunction>
-    std::vector<Document> FindAllDocuments(std::execution::parallel_policy, Query query, SortingFunction func) const;
-}; // main class
-
-template<template<typename...> typename Container>
-SearchServer::SearchServer(Container<std::string> stop_words_to_add)
-{
-    for (const std::string& word : stop_words_to_add)
-    {
-        if (!word.empty())
-        {
-            if (IsValidWord(word))
-                stop_words.insert(word);
-            else
-                throw std::invalid_argument("Word: " + word + "; contains a special symbol.");
-        }
-    }
-}
-template<template<typename...> typename Container>
-SearchServer::SearchServer(Container<std::string_view> stop_words_to_add)
-{
-    for (const std::string_view& word : stop_words_to_add)
-    {
-        if (!word.empty())
-        {
-            if (IsValidWord(word))
-                stop_words.insert(static_cast<std::string>(word));
-            else
-                throw std::invalid_argument("Word: " + static_cast<std::string>(word) + "; contains a special symbol.");
-        }
-    }
-}
-
-template <typename SortingFunction>
-std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, SortingFunction func) const
-{
-    // exeptions are handled inside of ParseQuery() function
-    Query query_words = ParseQuery(raw_query);
-    auto matched_documents = FindAllDocuments(query_words, func);
-
-    std::sort(matched_documents.begin(), matched_documents.end(),
-        [](const Document& lhs, const Document& rhs)
-        { return lhs.relevance > rhs.relevance || (std::abs(lhs.relevance - rhs.relevance) <= EPSILON && lhs.rating > rhs.rating); }
-    );
-
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT)
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
-
-    return matched_documents;
-} // Finds all matched documents (matching is determined by the function), then returns top ones (determine by MAX_RESULT_DOCUMENT_COUNT const)
-template <typename SortingFunction>
-std::vector<Document> SearchServer::FindTopDocuments(std::execution::sequenced_policy, std::string_view raw_query, SortingFunction func) const
-{
-    return FindTopDocuments(raw_query, func);
-}
-template <typename SortingFunction>
-std::vector<Document> SearchServer::FindTopDocuments(std::execution::parallel_policy, std::string_view raw_query, SortingFunction func) const
-{
-    // exeptions are handled inside of ParseQuery() function
-    Query query_words = ParseQuery(raw_query);
-    auto matched_documents = FindAllDocuments(std::execution::par, query_words, func);
-
-    std::sort(std::execution::par, matched_documents.begin(), matched_documents.end(),
-        [](const Document& lhs, const Document& rhs)
-        { return lhs.relevance > rhs.relevance || (std::abs(lhs.relevance - rhs.relevance) <= EPSILON && lhs.rating > rhs.rating); }
-    );
-
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT)
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
-
-    return matched_documents;
-}
-
-template <typename SortingFunction>
-std::vector<Document> SearchServer::FindAllDocuments(Query query, SortingFunction func) const
-{
-    //[id, relevance]
-    std::map<int, double> docs_id;
-    for (const std::string_view& word : query.plus_words)
-    {
-        if (word_to_document_freqs.count(word) == 0)
-            continue;
-        double relevance = CalculateIDF(word);
-        for (const auto& [id, tf] : word_to_document_freqs.at(word))
-        {
-            if (!func(id, doc_rating_status.at(id).status, doc_rating_status.at(id).rating))
-                continue; // Don't even bother checking documents of other type
-            docs_id[id] += relevance * tf;
-        }
-    }
-    for (const std::string_view& word : query.minus_words)
-    {
-        if (word_to_document_freqs.count(word) == 0)
-            continue;
-        for (const auto& [id, tf] : word_to_document_freqs.at(word))
-        {
-            docs_id.erase(id);
-        }
-    }
-    std::vector<Document> result;
-    for (const auto& [id, relevance] : docs_id)
-    {
-        result.push_back({ id, relevance, doc_rating_status.at(id).rating });
-    }
-    return result;
-} // Finds all somewhat relevant documents. Exeptance is regulated by the function with parameters: (id, status, rating)
-template <typename SortingFunction>
-std::vector<Document> SearchServer::FindAllDocuments(std::execution::sequenced_policy, Query query, SortingFunction func) const
-{
-    return FindAllDocuments(query, func);
-}
-template <typename SortingFunction>
-std::vector<Document> SearchServer::FindAllDocuments(std::execution::parallel_policy, Query query, SortingFunction func) const
-{
-    const int threads_num = 8;
-    //[id, relevance]
-    ConcurrentMap<int, double> docs_id(threads_num);
-    for_each
-    (
-        std::execution::par, query.plus_words.begin(), query.plus_words.end(),
-        [&](const std::string_view& word)
-        {
-            if (word_to_document_freqs.count(word) != 0)
-            {
-                double relevance = CalculateIDF(word);
-                for_each
-                (
-                    std::execution::par, word_to_document_freqs.at(word).begin(), word_to_document_freqs.at(word).end(),
-                    [&](const std::pair<int, double> item)
-                    {
-                        if (func(item.first, doc_rating_status.at(item.first).status, doc_rating_status.at(item.first).rating))
-                            docs_id[item.first].ref_to_value += relevance * item.second;
-                    }
-                );
-            }
-        }
-    );
-    for_each
-    (
-        std::execution::par, query.minus_words.begin(), query.minus_words.end(),
-        [&](const std::string_view& word)
-        {
-            if (word_to_document_freqs.count(word) != 0)
-            {
-                for (const auto& [id, tf] : word_to_document_freqs.at(word))
-                {
-                    docs_id.erase(id);
-                }
-            }
-        }
-    );
-    std::vector<Document> result;
-    for (const auto& [id, relevance] : docs_id.BuildOrdinaryMap())
-    {
-        result.push_back({ id, relevance, doc_rating_status.at(id).rating });
-    }
-    return result;
-} // Finds all somewhat relevant documents. Exeptance is regulated by the function with parameters: (id, status, rating)
\ No newline at end of file
+#pragma once
+
+#include <vector>
+#include <set>
+#include <map>
+#include <string>
+#include <cmath>
+#include <algorithm>
+#include <numeric>
+#include <functional>
+#include <stdexcept>
+#include <execution>
+#include <shared_mutex>
+#include <condition_variable>
+#include <thread>
+#include <array>
+#include <limits>
+#include <type_traits>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <span>
+#include <chrono>
+#include <stop_token>
+
+#include "document.h"
+#include "document_filter.h"
+#include "string_processing.h"
+#include "concurrent_map.h"
+#include "metrics.h"
+#include "adaptive_execution.h"
+#include "index_segment.h"
+#include "memory_tracking.h"
+#include "quantized_scoring.h"
+#include "term_trie.h"
+#include "levenshtein_automaton.h"
+#include "search_deadline.h"
+#include "task.h"
+#include "thread_pool.h"
+
+const double EPSILON = 1e-6;
+const int MAX_RESULT_DOCUMENT_COUNT = 5;
+const size_t SEGMENT_BUFFER_SIZE = 1024; // Documents of the mutable segment; once it is full, it is frozen and sealed in the background
+const size_t SEGMENT_MERGE_FACTOR = 8; // Sealed segments of the same size tier, that are merged into one
+const size_t COMPACTION_BATCH_SIZE = 64; // Sealed segment is rewritten alone to purge removed documents, once it has this many of them
+const double SEGMENT_DELETED_SHARE = 0.2; // ... and they make up this share of the segment
+const size_t UNLIMITED_MEMORY_BUDGET = std::numeric_limits<size_t>::max();
+const size_t MAX_PREFIX_EXPANSION = 16; // Words, that "prefix*" query word is expanded into: the most frequent ones, that start with it
+const int MAX_FUZZY_EDITS = 2; // Largest typo, that "word~N" query word tolerates
+const size_t MAX_FUZZY_EXPANSION = 16; // Words, that "word~" is expanded into: the closest ones, the most frequent first
+const double FUZZY_EDIT_WEIGHT = 0.5; // Every edit halves the weight of a word, that was found by typo tolerance
+const size_t SNIPPET_WORD_COUNT = 24; // Words in the window of a snippet
+const size_t DEADLINE_CHECK_POSTINGS = 1024; // Postings, that a search with a deadline traverses between two checks of it
+
+bool IsValidWord(std::string_view word);
+bool IsCorrectMinus(std::string_view word);
+bool IsMinusWord(std::string_view word);
+bool IsPrefixWord(std::string_view word); // "prefix*"
+bool IsFuzzyWord(std::string_view word); // "word~" or "word~N"
+int ComputeIntegerAverage(const std::vector<int>& values);
+
+using WordFrequencies = std::map<std::string_view, double>; // [word, term frequency]
+
+// Memory of every index structure. Containers of SearchServer allocate through their own TrackingMemoryResource,
+// so they are counted exactly; segments are immutable and shared with the merge thread, so they are estimated
+struct SearchServerMemoryStats
+{
+    MemoryUsage documents; // Texts of the documents
+    MemoryUsage forward_index; // Packed word ids and term frequencies of every document
+    MemoryUsage dictionary; // Words, their ids and document counts
+    MemoryUsage stop_words;
+    MemoryUsage doc_rating_status;
+    MemoryUsage ids;
+    MemoryUsage segments; // Postings of the buffer and of the sealed segments, with their deleted ids
+
+    MemoryUsage GetTotal() const;
+};
+
+class SearchServer
+{
+public:
+#pragma region Constructors
+    // Every parallel and asynchronous search runs on the thread pool of the server, configured by executor_options.
+    // The cost model of adaptive_policy is calibrated on the first pool of every size, which takes about a hundred ms with several threads
+    SearchServer() = default;
+    template<template<typename...> typename Container>
+    explicit SearchServer(Container<std::string> stop_words_to_add, ThreadPoolOptions executor_options = {});
+    template<template<typename...> typename Container>
+    explicit SearchServer(Container<std::string_view> stop_words_to_add, ThreadPoolOptions executor_options = {});
+    //explicit SearchServer(const std::string_view& stop_words_text) : SearchServer(SplitIntoWords(stop_words_text)) {} -> For some reason, this one tries to call itself, but next one is working
+    explicit SearchServer(std::string_view stop_words_text, ThreadPoolOptions executor_options = {}) : executor(executor_options)
+    {
+        for (const std::string_view& word : SplitIntoWords(stop_words_text))
+        {
+            if (!word.empty())
+            {
+                if (IsValidWord(word))
+                    stop_words.emplace(word);
+                else
+                    throw std::invalid_argument("Word: " + static_cast<std::string>(word) + "; contains a special symbol.");
+            }
+        }
+    }
+#pragma endregion
+    void AddDocument(int document_id, std::string_view text_document, DocumentStatus status, const std::vector<int>& ratings);
+    void RemoveDocument(int document_id);
+    void RemoveDocument(std::execution::sequenced_policy policy, int document_id);
+    void RemoveDocument(std::execution::parallel_policy policy, int document_id);
+    void RemoveDocument(AdaptivePolicy policy, int document_id);
+    void CompactRemovedDocuments(); // Purges all removed documents right away, without waiting for the background merges
+
+    // DocumentFilter is pushed down into the index and skips whole partitions of postings.
+    // SortingFunction is called for every posting, that passed the filter, so it is the slow path
+    template <typename SortingFunction>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, const DocumentFilter& filter, SortingFunction func) const;
+    template <typename SortingFunction>
+    std::vector<Document> FindTopDocuments(std::execution::sequenced_policy, std::string_view raw_query, const DocumentFilter& filter, SortingFunction func) const;
+    template <typename SortingFunction>
+    std::vector<Document> FindTopDocuments(std::execution::parallel_policy, std::string_view raw_query, const DocumentFilter& filter, SortingFunction func) const;
+    template <typename SortingFunction>
+    std::vector<Document> FindTopDocuments(AdaptivePolicy, std::string_view raw_query, const DocumentFilter& filter, SortingFunction func) const;
+    template <typename SortingFunction>
+    std::vector<Document> FindTopDocuments(QuantizedPolicy, std::string_view raw_query, const DocumentFilter& filter, SortingFunction func) const;
+
+    template <typename SortingFunction>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, SortingFunction func) const;
+    template <typename SortingFunction>
+    std::vector<Document> FindTopDocuments(std::execution::sequenced_policy, std::string_view raw_query, SortingFunction func) const;
+    template <typename SortingFunction>
+    std::vector<Document> FindTopDocuments(std::execution::parallel_policy, std::string_view raw_query, SortingFunction func) const;
+    template <typename SortingFunction>
+    std::vector<Document> FindTopDocuments(AdaptivePolicy, std::string_view raw_query, SortingFunction func) const;
+    template <typename SortingFunction>
+    std::vector<Document> FindTopDocuments(QuantizedPolicy, std::string_view raw_query, SortingFunction func) const;
+
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status = DocumentStatus::ACTUAL) const;
+    std::vector<Document> FindTopDocuments(std::execution::sequenced_policy, std::string_view raw_query, DocumentStatus status = DocumentStatus::ACTUAL) const;
+    std::vector<Document> FindTopDocuments(std::execution::parallel_policy, std::string_view raw_query, DocumentStatus status = DocumentStatus::ACTUAL) const;
+    std::vector<Document> FindTopDocuments(AdaptivePolicy, std::string_view raw_query, DocumentStatus status = DocumentStatus::ACTUAL) const;
+    std::vector<Document> FindTopDocuments(QuantizedPolicy, std::string_view raw_query, DocumentStatus status = DocumentStatus::ACTUAL) const;
+
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, const DocumentFilter& filter) const;
+    std::vector<Document> FindTopDocuments(std::execution::sequenced_policy, std::string_view raw_query, const DocumentFilter& filter) const;
+    std::vector<Document> FindTopDocuments(std::execution::parallel_policy, std::string_view raw_query, const DocumentFilter& filter) const;
+    std::vector<Document> FindTopDocuments(AdaptivePolicy, std::string_view raw_query, const DocumentFilter& filter) const;
+    std::vector<Document> FindTopDocuments(QuantizedPolicy, std::string_view raw_query, const DocumentFilter& filter) const;
+
+    // Runs the search on the internal executor and never blocks the awaiting coroutine. Posting traversal checks the deadline and
+    // stop_token between blocks of postings; once either is reached, it returns the top of the documents scored so far, marked as truncated.
+    // Query and filter are copied into the coroutine, as it outlives the call
+    Task<TopDocumentsResult> FindTopDocumentsAsync(std::string raw_query, SearchDeadline::Clock::time_point deadline, std::stop_token stop_token = {}) const;
+    Task<TopDocumentsResult> FindTopDocumentsAsync(std::string raw_query, DocumentFilter filter, SearchDeadline::Clock::time_point deadline, std::stop_token stop_token = {}) const;
+
+    // Top documents, each with the window of SNIPPET_WORD_COUNT words of its text, that covers the most weight of distinct query words.
+    // Text is rescanned for the top documents only. Snippets point into the stored text, so they stay valid, until the document is removed
+    std::vector<DocumentSnippet> FindTopDocumentsWithSnippets(std::string_view raw_query, DocumentStatus status = DocumentStatus::ACTUAL) const;
+    std::vector<DocumentSnippet> FindTopDocumentsWithSnippets(std::string_view raw_query, const DocumentFilter& filter) const;
+
+    // Matched words point into raw_query: a word, that "prefix*" or "word~" is expanded into, is given as that query word
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::string_view raw_query, int document_id) const;
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::execution::sequenced_policy policy, std::string_view raw_query, int document_id) const;
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::execution::parallel_policy policy, std::string_view raw_query, int document_id) const;
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(AdaptivePolicy policy, std::string_view raw_query, int document_id) const;
+
+    // Matches one query against many documents, parsing the query only once. Results are in the order of document_ids
+    std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> MatchDocuments(std::string_view raw_query, const std::vector<int>& document_ids) const;
+    std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> MatchDocuments(std::execution::sequenced_policy policy, std::string_view raw_query, const std::vector<int>& document_ids) const;
+    std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> MatchDocuments(std::execution::parallel_policy policy, std::string_view raw_query, const std::vector<int>& document_ids) const;
+    std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> MatchDocuments(AdaptivePolicy policy, std::string_view raw_query, const std::vector<int>& document_ids) const;
+
+    int GetDocumentCount() const;
+    // Known words, that start with prefix, the most frequent (by document count) first. "prefix*" in a query is expanded into
+    // the first MAX_PREFIX_EXPANSION of them
+    std::vector<WordSuggestion> Suggest(std::string_view prefix, size_t max_count) const;
+    // Map is built from the forward index (or from the postings without it) on every call, nothing is kept for the document.
+    // Keys point into the dictionary and stay valid, until the document is removed. Frequencies are rounded to float
+    WordFrequencies GetWordFrequencies(int document_id) const;
+    std::vector<int> GetWordIds(int document_id) const; // Sorted ids of the words of the document; empty for unknown document
+
+    SearchServerMemoryStats GetMemoryStats() const;
+    // Pool, that runs the parallel searches. Batches of queries are run on it as well, so they share the threads
+    // with the parallel parts of every query instead of oversubscribing the CPUs
+    ThreadPool& GetThreadPool() const;
+    // Once the memory of the whole index goes over the budget, the forward index is dropped: MatchDocument, RemoveDocument
+    // and GetWordFrequencies fall back to the postings then. Budget is checked, whenever the write buffer is frozen and on this call. If the forward index
+    // is already dropped and the index fits into the new budget together with its estimated size, it is rebuilt from the postings
+    void SetMemoryBudget(size_t max_bytes);
+    bool HasForwardIndex() const;
+    auto begin()
+    {
+        return ids.begin();
+    }
+    auto end()
+    {
+        return ids.end();
+    }
+private:
+    struct Rating_Status
+    {
+        int rating;
+        DocumentStatus status;
+    };
+    struct IndexedWord
+    {
+        std::string_view word; // Points into the key of dictionary; empty for released ids
+        int document_count = 0; // Documents, that contain the word, used for IDF
+        size_t posting_count = 0; // Postings of the word in all segments, including the ones of removed documents, that are not purged yet
+    }; // Word is dropped, once its last posting is purged, so no segment can refer to its id anymore
+    struct SegmentSlot
+    {
+        std::shared_ptr<const SegmentBuffer> frozen_buffer; // Full buffer, waiting to be sealed
+        std::shared_ptr<const SealedSegment> segment; // nullptr, until the buffer is sealed
+        RoaringBitmap deleted_ids; // Removed documents, that still have postings in the segment
+
+        bool ContainsDocument(int document_id) const; // Including the removed ones
+        size_t GetDocumentCount() const;
+        bool HasTooManyDeleted() const; // Sealed segment should be rewritten alone to purge them
+    }; // Both buffer and segment are shared with the background thread, that may be reading them
+
+    // Every structure allocates through its own resource, so GetMemoryStats can tell them apart. Declared before the containers, which use them
+    TrackingMemoryResource documents_memory;
+    TrackingMemoryResource forward_index_memory;
+    TrackingMemoryResource dictionary_memory;
+    TrackingMemoryResource stop_words_memory;
+    TrackingMemoryResource doc_rating_status_memory;
+    TrackingMemoryResource ids_memory;
+
+    std::pmr::map<int, std::pmr::string> documents{ &documents_memory };
+    std::pmr::map<int, std::pmr::vector<DocumentWord>> forward_index{ &forward_index_memory }; // Words of every document, sorted by word id
+    std::pmr::map<std::pmr::string, int, std::less<>> dictionary{ &dictionary_memory }; // [word, word id]; owns the words, so removed documents text can be freed
+    std::pmr::vector<IndexedWord> indexed_words{ &dictionary_memory }; // [word id]
+    std::pmr::vector<int> free_word_ids{ &dictionary_memory }; // Ids of words that were purged away, reused by new words
+    TermTrie terms{ &dictionary_memory }; // Same words as dictionary, with their document counts, for prefix lookups
+    std::pmr::set<std::pmr::string, std::less<>> stop_words{ &stop_words_memory };
+    std::pmr::map<int, Rating_Status> doc_rating_status{ &doc_rating_status_memory };
+    std::pmr::set<int> ids{ &ids_memory };
+
+    bool forward_index_enabled = true; // Without it, forward_index is empty and words of a document are looked up in the postings
+    size_t memory_budget = UNLIMITED_MEMORY_BUDGET;
+
+    // Tiered index: new documents go into the mutable buffer, which is frozen, once it is full. Background thread seals frozen
+    // buffers into immutable segments and merges them. Every document lives in exactly one of the segments
+    SegmentBuffer buffer;
+    std::vector<SegmentSlot> segments;
+    mutable std::shared_mutex index_mutex; // Queries take it shared, modifications take it unique
+    std::condition_variable_any merge_condition;
+    mutable ThreadPool executor; // Runs parallel and asynchronous searches
+    ExecutionCostModel cost_model{ executor }; // Calibrated, when the first server with a pool of this size is constructed, so no query pays for it
+    std::jthread merger; // Declared last, so it is stopped before any of the data above is destroyed
+
+    struct Query
+    {
+        std::vector<std::string_view> plus_words;
+        std::vector<std::string_view> minus_words;
+        std::vector<std::pair<std::string_view, double>> fuzzy_words; // [plus word, weight], found by typo tolerance only, so they weigh less
+        // [plus or fuzzy word, word of the raw query, that it came from: the word itself, or "prefix*" and "word~" for expanded ones], sorted.
+        // Expanded words point into the dictionary, so only the words of the raw query are given out to the caller
+        std::vector<std::pair<std::string_view, std::string_view>> plus_word_sources;
+    };
+    enum class WordStatus
+    {
+        Plus = 0,
+        Minus = 1
+    };
+    struct Word
+    {
+        std::string_view word;
+        WordStatus status;
+    };
+    struct PreparedQuery
+    {
+        std::vector<std::pair<int, std::string_view>> plus_words; // [word id, word of the raw query, that matches it], sorted by id
+        std::vector<int> minus_word_ids; // sorted
+    }; // Query with words resolved into ids; unknown words are dropped, as they can't match anything
+    struct SegmentQuery
+    {
+        std::vector<std::pair<int, double>> plus_words; // [word id, IDF]
+        std::vector<int> minus_word_ids;
+    }; // Query resolved against the dictionary once, so every segment is searched by word ids and global IDF
+
+    bool IsStopWord(std::string_view word) const; // check if it is a non relevant word
+
+    Word ValidateWord(std::string_view word) const;
+    std::vector<std::string_view> SplitIntoWordsNoStop(std::string_view text) const; // Parse text, excluding non important words
+
+    Query ParseQuery(std::string_view text) const; // Returns 2 sets of plus and minus words separatly (in that order)
+    Query ParseQuery(std::execution::sequenced_policy policy, std::string_view text) const;
+    void ExpandPrefix(std::string_view prefix_word, std::vector<std::string_view>& words) const; // Adds known words, that "prefix*" stands for
+    std::vector<std::pair<std::string_view, double>> FindFuzzyWords(std::string_view fuzzy_word) const; // Known words within the edits of "word~N", with their weights
+
+    double CalculateIDF(const IndexedWord& word) const; // Inverse Document Frequency for word
+    size_t CountQueryPostings(const SegmentQuery& query, const DocumentFilter& filter) const; // Amount of work for the cost model: postings, that filter lets through
+    static bool IsPartitionAccepted(const DocumentFilter& filter, size_t status, const PostingPartition& partition);
+    static bool IsMoreRelevant(const Document& lhs, const Document& rhs); // Order of the results
+    void AppendTopDocuments(const std::map<int, double>& docs_id, std::vector<Document>& result) const; // Adds the top MAX_RESULT_DOCUMENT_COUNT of [id, relevance]
+    template <typename Action>
+    static void ForEachAllowedPosting(std::span<const Posting> postings, const DocumentFilter& filter, const RoaringBitmap& deleted_ids, Action action); // Calls action(posting) for postings, that pass id sets of the filter and are not deleted
+    template <typename Visitor>
+    void ForEachSegment(Visitor visitor) const; // Calls visitor(segment, deleted_ids) for the buffer and every sealed segment
+
+    int AllocateWordId(std::string_view word); // word has to be a key of dictionary
+    void ReleasePurgedPostings(const PurgedPostings& purged); // Drops words, that lost their last posting
+    void PurgeDocument(int document_id); // Frees everything but the postings of the document
+    PreparedQuery PrepareQuery(const Query& query) const;
+    SegmentQuery ResolveQuery(const Query& query) const;
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchPreparedQuery(const PreparedQuery& query, int document_id) const;
+    std::vector<DocumentWord> FindQueryWords(const PreparedQuery& query, int document_id) const; // Query words, that document has, found in the postings; sorted by word id
+    std::vector<DocumentWord> FindDocumentWords(int document_id) const; // Words of the document, found in the postings
+    std::span<const DocumentWord> GetDocumentWords(int document_id, std::vector<DocumentWord>& posting_words) const; // From the forward index, or found in the postings and kept in posting_words
+    template <typename Visitor>
+    void VisitDocumentSegment(int document_id, Visitor visitor) const; // Calls visitor(segment) for the segment, where the document is alive
+
+    SearchServerMemoryStats CollectMemoryStats() const;
+    MemoryUsage EstimateForwardIndexUsage() const; // Of the forward index, that RebuildForwardIndex would build from the postings
+
+    // All of them require unique lock of index_mutex
+    void EnforceMemoryBudget(); // Drops the forward index, if the index does not fit into the budget
+    void RebuildForwardIndex();
+    void FreezeBuffer();
+    bool HasFrozenBuffer() const;
+    std::vector<size_t> SelectMergeSegments() const; // Indexes of the segments to merge next; empty, if no merge is needed
+    void ReplaceSegments(const std::vector<std::shared_ptr<const SealedSegment>>& merged_segments, const std::vector<RoaringBitmap>& merged_deleted_ids,
+        std::shared_ptr<const SealedSegment> segment, const PurgedPostings& purged);
+    void MergeLoop(std::stop_token stop_token); // Seals frozen buffers and merges segments
+
+    template <typename SortingFunction>
+    std::vector<Document> FindAllDocuments(SegmentQuery query, const DocumentFilter& filter, SortingFunction func, SearchDeadline* deadline = nullptr) const; // Stops early, once the deadline is reached
+    template <typename SortingFunction>
+    std::vector<Document> FindAllDocuments(std::execution::parallel_policy, const SegmentQuery& query, const DocumentFilter& filter, SortingFunction func, size_t grain_size = DEFAULT_PARALLEL_GRAIN_SIZE) const;
+    template <typename SortingFunction>
+    std::vector<Document> FindTopDocuments(std::execution::parallel_policy, std::string_view raw_query, const DocumentFilter& filter, SortingFunction func, size_t grain_size) const;
+    TopDocumentsResult FindTopDocumentsUntil(std::string_view raw_query, const DocumentFilter& filter, SearchDeadline& deadline) const;
+    DocumentSnippet MakeSnippet(const Document& document, const std::vector<std::pair<std::string_view, double>>& query_words) const; // query_words: [word, weight], sorted by word
+    template <typename SortingFunction>
+    std::vector<Document> FindQuantizedDocuments(const SegmentQuery& query, const DocumentFilter& filter, SortingFunction func) const; // Top documents, already in order
+}; // main class
+
+template<template<typename...> typename Container>
+SearchServer::SearchServer(Container<std::string> stop_words_to_add, ThreadPoolOptions executor_options) : executor(executor_options)
+{
+    for (const std::string& word : stop_words_to_add)
+    {
+        if (!word.empty())
+        {
+            if (IsValidWord(word))
+                stop_words.emplace(word);
+            else
+                throw std::invalid_argument("Word: " + word + "; contains a special symbol.");
+        }
+    }
+}
+template<template<typename...> typename Container>
+SearchServer::SearchServer(Container<std::string_view> stop_words_to_add, ThreadPoolOptions executor_options) : executor(executor_options)
+{
+    for (const std::string_view& word : stop_words_to_add)
+    {
+        if (!word.empty())
+        {
+            if (IsValidWord(word))
+                stop_words.emplace(word);
+            else
+                throw std::invalid_argument("Word: " + static_cast<std::string>(word) + "; contains a special symbol.");
+        }
+    }
+}
+
+template <typename SortingFunction>
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, const DocumentFilter& filter, SortingFunction func) const
+{
+    METRIC_COUNT(MetricCounter::QUERIES, 1);
+    std::shared_lock lock(index_mutex);
+    // exeptions are handled inside of ParseQuery() function
+    auto matched_documents = FindAllDocuments(ResolveQuery(ParseQuery(raw_query)), filter, func);
+    lock.unlock();
+
+    METRIC_TIMER(MetricTimer::TOP_K_SELECTION);
+    std::sort(matched_documents.begin(), matched_documents.end(), IsMoreRelevant);
+
+    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT)
+        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+
+    return matched_documents;
+} // Finds top matched documents of every segment (matching is determined by the filter and the function), then returns top ones of them (determine by MAX_RESULT_DOCUMENT_COUNT const)
+template <typename SortingFunction>
+std::vector<Document> SearchServer::FindTopDocuments(std::execution::sequenced_policy, std::string_view raw_query, const DocumentFilter& filter, SortingFunction func) const
+{
+    return FindTopDocuments(raw_query, filter, func);
+}
+template <typename SortingFunction>
+std::vector<Document> SearchServer::FindTopDocuments(std::execution::parallel_policy policy, std::string_view raw_query, const DocumentFilter& filter, SortingFunction func) const
+{
+    return FindTopDocuments(policy, raw_query, filter, func, DEFAULT_PARALLEL_GRAIN_SIZE);
+}
+template <typename SortingFunction>
+std::vector<Document> SearchServer::FindTopDocuments(AdaptivePolicy, std::string_view raw_query, const DocumentFilter& filter, SortingFunction func) const
+{
+    METRIC_COUNT(MetricCounter::QUERIES, 1);
+    std::shared_lock lock(index_mutex);
+    // exeptions are handled inside of ParseQuery() function. Query is parsed and resolved once, for both the estimate and the search
+    const SegmentQuery query = ResolveQuery(ParseQuery(raw_query));
+    const ExecutionPlan plan = cost_model.Plan(CountQueryPostings(query, filter));
+    std::vector<Document> matched_documents;
+    if (plan.parallel)
+    {
+        ExecutionCostModel::ParallelCallGuard parallel_call;
+        matched_documents = FindAllDocuments(std::execution::par, query, filter, func, plan.grain_size);
+    }
+    else
+        matched_documents = FindAllDocuments(query, filter, func);
+    lock.unlock();
+
+    METRIC_TIMER(MetricTimer::TOP_K_SELECTION);
+    std::sort(matched_documents.begin(), matched_documents.end(), IsMoreRelevant);
+
+    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT)
+        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+
+    return matched_documents;
+} // Runs in parallel only when the cost model expects it to pay off for this query and current load
+template <typename SortingFunction>
+std::vector<Document> SearchServer::FindTopDocuments(QuantizedPolicy, std::string_view raw_query, const DocumentFilter& filter, SortingFunction func) const
+{
+    METRIC_COUNT(MetricCounter::QUERIES, 1);
+    std::shared_lock lock(index_mutex);
+    // exeptions are handled inside of ParseQuery() function
+    return FindQuantizedDocuments(ResolveQuery(ParseQuery(raw_query)), filter, func);
+} // Same documents as the other policies, ranked by fixed point scores (see QuantizedPolicy)
+template <typename SortingFunction>
+std::vector<Document> SearchServer::FindTopDocuments(std::execution::parallel_policy, std::string_view raw_query, const DocumentFilter& filter, SortingFunction func, size_t grain_size) const
+{
+    METRIC_COUNT(MetricCounter::QUERIES, 1);
+    ExecutionCostModel::ParallelCallGuard parallel_call;
+    std::shared_lock lock(index_mutex);
+    // exeptions are handled inside of ParseQuery() function
+    auto matched_documents = FindAllDocuments(std::execution::par, ResolveQuery(ParseQuery(raw_query)), filter, func, grain_size);
+    lock.unlock();
+
+    METRIC_TIMER(MetricTimer::TOP_K_SELECTION);
+    std::sort(matched_documents.begin(), matched_documents.end(), IsMoreRelevant); // FindAllDocuments has left only the top documents to sort
+
+    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT)
+        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+
+    return matched_documents;
+}
+
+template <typename SortingFunction>
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, SortingFunction func) const
+{
+    return FindTopDocuments(raw_query, DocumentFilter(), func);
+}
+template <typename SortingFunction>
+std::vector<Document> SearchServer::FindTopDocuments(std::execution::sequenced_policy, std::string_view raw_query, SortingFunction func) const
+{
+    return FindTopDocuments(raw_query, DocumentFilter(), func);
+}
+template <typename SortingFunction>
+std::vector<Document> SearchServer::FindTopDocuments(std::execution::parallel_policy policy, std::string_view raw_query, SortingFunction func) const
+{
+    return FindTopDocuments(policy, raw_query, DocumentFilter(), func);
+}
+template <typename SortingFunction>
+std::vector<Document> SearchServer::FindTopDocuments(AdaptivePolicy policy, std::string_view raw_query, SortingFunction func) const
+{
+    return FindTopDocuments(policy, raw_query, DocumentFilter(), func);
+}
+template <typename SortingFunction>
+std::vector<Document> SearchServer::FindTopDocuments(QuantizedPolicy policy, std::string_view raw_query, SortingFunction func) const
+{
+    return FindTopDocuments(policy, raw_query, DocumentFilter(), func);
+}
+
+template <typename SortingFunction>
+std::vector<Document> SearchServer::FindAllDocuments(SegmentQuery segment_query, const DocumentFilter& filter, SortingFunction func, SearchDeadline* deadline) const
+{
+    // Status comes from the partition and rating from the posting, so no document metadata is looked up while scoring
+    constexpr bool has_predicate = !std::is_same_v<SortingFunction, AcceptAllDocuments>;
+    // Without a deadline, every partition is a single block
+    const size_t block_size = deadline != nullptr ? DEADLINE_CHECK_POSTINGS : std::numeric_limits<size_t>::max();
+    const auto is_stopped = [deadline]() { return deadline != nullptr && deadline->IsReached(); };
+    if (deadline != nullptr)
+    {
+        // Rare words weigh the most, so a search, that is cut short, has scored them already
+        std::sort(segment_query.plus_words.begin(), segment_query.plus_words.end(), [](const auto& lhs, const auto& rhs) { return lhs.second > rhs.second; });
+    }
+
+    // Every document lives in exactly one segment, so segments are scored independently and only their top documents are merged
+    std::vector<std::map<int, double>> segments_docs_id; //[id, relevance] of every segment
+    {
+        METRIC_TIMER(MetricTimer::POSTING_TRAVERSAL);
+        ForEachSegment([&](const auto& segment, const RoaringBitmap& deleted_ids)
+            {
+                if (is_stopped())
+                    return; // Segments, that were not started, are left out of a truncated search
+                std::map<int, double>& docs_id = segments_docs_id.emplace_back();
+                for (const auto& [word_id, relevance] : segment_query.plus_words)
+                {
+                    const WordPartitions partitions = segment.FindWord(word_id);
+                    for (size_t status = 0; status < DOCUMENT_STATUS_COUNT; status++)
+                    {
+                        const PostingPartition& partition = partitions[status];
+                        if (!IsPartitionAccepted(filter, status, partition))
+                            continue; // Don't even bother checking documents of other type
+                        const bool check_rating = !filter.AcceptsAllRatings(partition.min_rating, partition.max_rating);
+                        for (size_t begin = 0; begin < partition.postings.size() && !is_stopped(); begin += block_size)
+                        {
+                            const std::span<const Posting> block = partition.postings.subspan(begin, std::min(block_size, partition.postings.size() - begin));
+                            METRIC_COUNT(MetricCounter::POSTINGS_VISITED, block.size());
+                            ForEachAllowedPosting(block, filter, deleted_ids, [&](const Posting& posting)
+                                {
+                                    if (check_rating && !filter.AcceptsRating(posting.rating))
+                                        return;
+                                    if (has_predicate && !func(posting.document_id, static_cast<DocumentStatus>(status), posting.rating))
+                                        return;
+                                    docs_id[posting.document_id] += relevance * posting.term_frequency;
+                                });
+                        }
+                    }
+                }
+                // Minus words are never cut short, a truncated result still has none of them
+                for (int word_id : segment_query.minus_word_ids)
+                {
+                    const WordPartitions partitions = segment.FindWord(word_id);
+                    for (size_t status = 0; status < DOCUMENT_STATUS_COUNT; status++)
+                    {
+                        const PostingPartition& partition = partitions[status];
+                        if (!IsPartitionAccepted(filter, status, partition))
+                            continue; // Documents of rejected partitions were never scored
+                        METRIC_COUNT(MetricCounter::POSTINGS_VISITED, partition.postings.size());
+                        for (const Posting& posting : partition.postings)
+                        {
+                            docs_id.erase(posting.document_id);
+                        }
+                    }
+                }
+            });
+    }
+    METRIC_TIMER(MetricTimer::SCORING);
+    std::vector<Document> result;
+    for (const std::map<int, double>& docs_id : segments_docs_id)
+    {
+        METRIC_COUNT(MetricCounter::DOCUMENTS_SCORED, docs_id.size());
+        AppendTopDocuments(docs_id, result);
+    }
+    return result;
+} // Finds top relevant documents of every segment. Exeptance is regulated by the filter and the function with parameters: (id, status, rating)
+template <typename SortingFunction>
+std::vector<Document> SearchServer::FindAllDocuments(std::execution::parallel_policy, const SegmentQuery& segment_query, const DocumentFilter& filter, SortingFunction func, size_t grain_size) const
+{
+    struct PostingChunk
+    {
+        std::span<const Posting> postings;
+        const RoaringBitmap* deleted_ids;
+        double relevance;
+        DocumentStatus status; // Every posting of a chunk comes from the same partition
+        bool check_rating;
+    };
+    constexpr bool has_predicate = !std::is_same_v<SortingFunction, AcceptAllDocuments>;
+
+    const int threads_num = 8;
+    //[id, relevance]
+    ConcurrentMap<int, double> docs_id(threads_num);
+    {
+        METRIC_TIMER(MetricTimer::POSTING_TRAVERSAL);
+        // Accepted partitions of all words in all segments are cut into flat list of chunks, so a single parallel loop covers the whole query
+        std::vector<PostingChunk> chunks;
+        std::vector<PostingChunk> minus_chunks;
+        ForEachSegment([&](const auto& segment, const RoaringBitmap& deleted_ids)
+            {
+                for (const auto& [word_id, relevance] : segment_query.plus_words)
+                {
+                    const WordPartitions partitions = segment.FindWord(word_id);
+                    for (size_t status = 0; status < DOCUMENT_STATUS_COUNT; status++)
+                    {
+                        const PostingPartition& partition = partitions[status];
+                        if (!IsPartitionAccepted(filter, status, partition))
+                            continue;
+                        METRIC_COUNT(MetricCounter::POSTINGS_VISITED, partition.postings.size());
+                        const bool check_rating = !filter.AcceptsAllRatings(partition.min_rating, partition.max_rating);
+                        for (size_t begin = 0; begin < partition.postings.size(); begin += grain_size)
+                        {
+                            chunks.push_back({ partition.postings.subspan(begin, std::min(grain_size, partition.postings.size() - begin)), &deleted_ids, relevance, static_cast<DocumentStatus>(status), check_rating });
+                        }
+                    }
+                }
+                for (int word_id : segment_query.minus_word_ids)
+                {
+                    const WordPartitions partitions = segment.FindWord(word_id);
+                    for (size_t status = 0; status < DOCUMENT_STATUS_COUNT; status++)
+                    {
+                        const PostingPartition& partition = partitions[status];
+                        if (!IsPartitionAccepted(filter, status, partition))
+                            continue;
+                        METRIC_COUNT(MetricCounter::POSTINGS_VISITED, partition.postings.size());
+                        minus_chunks.push_back({ partition.postings, &deleted_ids, 0.0, static_cast<DocumentStatus>(status), false });
+                    }
+                }
+            });
+        executor.ParallelFor
+        (
+            chunks.size(),
+            [&](size_t chunk_index)
+            {
+                const PostingChunk& chunk = chunks[chunk_index];
+                ForEachAllowedPosting(chunk.postings, filter, *chunk.deleted_ids, [&](const Posting& posting)
+                    {
+                        if (chunk.check_rating && !filter.AcceptsRating(posting.rating))
+                            return;
+                        if (has_predicate && !func(posting.document_id, chunk.status, posting.rating))
+                            return;
+                        docs_id[posting.document_id].ref_to_value += chunk.relevance * posting.term_frequency;
+                    });
+            }
+        );
+        // Deleted postings are skipped here too: the same id may be alive in another segment
+        executor.ParallelFor
+        (
+            minus_chunks.size(),
+            [&](size_t chunk_index)
+            {
+                const PostingChunk& chunk = minus_chunks[chunk_index];
+                ForEachAllowedPosting(chunk.postings, filter, *chunk.deleted_ids, [&](const Posting& posting)
+                    {
+                        docs_id.erase(posting.document_id);
+                    });
+            }
+        );
+    }
+    METRIC_TIMER(MetricTimer::SCORING);
+    const std::map<int, double> all_docs_id = docs_id.BuildOrdinaryMap();
+    METRIC_COUNT(MetricCounter::DOCUMENTS_SCORED, all_docs_id.size());
+    std::vector<Document> result;
+    AppendTopDocuments(all_docs_id, result);
+    return result;
+} // Finds top relevant documents of all segments. Exeptance is regulated by the filter and the function with parameters: (id, status, rating)
+template <typename SortingFunction>
+std::vector<Document> SearchServer::FindQuantizedDocuments(const SegmentQuery& segment_query, const DocumentFilter& filter, SortingFunction func) const
+{
+    std::vector<double> idfs;
+    for (const auto& [word_id, idf] : segment_query.plus_words)
+    {
+        idfs.push_back(idf);
+    }
+    const QuantizedScale scale(idfs);
+
+    // Postings are added to the dense scores without any per posting check. Id sets, deleted ids, ratings and the predicate
+    // are checked once per matched document instead, when the scores are read out
+    std::vector<QuantizedCandidate> candidates;
+    QuantizedAccumulator accumulator;
+    ForEachSegment([&](const auto& segment, const RoaringBitmap& deleted_ids)
+        {
+            const auto document_ids = segment.GetDocumentIds(); // [ordinal] -> id
+            const auto add_postings = [&](const PostingPartition& partition, uint32_t idf, bool exclude)
+            {
+                METRIC_COUNT(MetricCounter::POSTINGS_VISITED, partition.postings.size());
+                if (!exclude && !partition.ordinals.empty())
+                {
+                    accumulator.Add(partition.ordinals, partition.quantized_tfs, idf);
+                    return;
+                }
+                // The buffer has no quantized postings, they are quantized on the fly; it holds few documents
+                for (size_t i = 0; i < partition.postings.size(); i++)
+                {
+                    const uint32_t ordinal = !partition.ordinals.empty() ? partition.ordinals[i]
+                        : static_cast<uint32_t>(std::lower_bound(document_ids.begin(), document_ids.end(), static_cast<uint32_t>(partition.postings[i].document_id)) - document_ids.begin());
+                    if (exclude)
+                        accumulator.Exclude(ordinal);
+                    else
+                        accumulator.Add(ordinal, QuantizeTermFrequency(partition.postings[i].term_frequency), idf);
+                }
+            };
+            {
+                METRIC_TIMER(MetricTimer::POSTING_TRAVERSAL);
+                accumulator.Reset(document_ids.size());
+                for (size_t word_index = 0; word_index < segment_query.plus_words.size(); word_index++)
+                {
+                    const WordPartitions partitions = segment.FindWord(segment_query.plus_words[word_index].first);
+                    for (size_t status = 0; status < DOCUMENT_STATUS_COUNT; status++)
+                    {
+                        if (IsPartitionAccepted(filter, status, partitions[status]))
+                            add_postings(partitions[status], scale.GetIdf(word_index), false);
+                    }
+                }
+                for (int word_id : segment_query.minus_word_ids)
+                {
+                    const WordPartitions partitions = segment.FindWord(word_id);
+                    for (size_t status = 0; status < DOCUMENT_STATUS_COUNT; status++)
+                    {
+                        if (IsPartitionAccepted(filter, status, partitions[status]))
+                            add_postings(partitions[status], 0, true);
+                    }
+                }
+            }
+
+            METRIC_TIMER(MetricTimer::SCORING);
+            const size_t segment_begin = candidates.size();
+            const std::span<const uint32_t> scores = accumulator.GetScores();
+            for (size_t ordinal = 0; ordinal < scores.size(); ordinal++)
+            {
+                if ((scores[ordinal] & MATCHED_SCORE_FLAG) == 0)
+                    continue;
+                const int id = static_cast<int>(document_ids[ordinal]);
+                if (deleted_ids.Contains(static_cast<uint32_t>(id)) || !filter.AcceptsId(id))
+                    continue;
+                const Rating_Status& rating_status = doc_rating_status.at(id);
+                if (!filter.AcceptsRating(rating_status.rating) || !func(id, rating_status.status, rating_status.rating))
+                    continue;
+                candidates.push_back({ scores[ordinal] & MAX_QUANTIZED_SCORE, rating_status.rating, id });
+            }
+            METRIC_COUNT(MetricCounter::DOCUMENTS_SCORED, candidates.size() - segment_begin);
+            if (candidates.size() - segment_begin > MAX_RESULT_DOCUMENT_COUNT)
+            {
+                std::partial_sort(candidates.begin() + segment_begin, candidates.begin() + segment_begin + MAX_RESULT_DOCUMENT_COUNT, candidates.end(), IsHigherScored);
+                candidates.resize(segment_begin + MAX_RESULT_DOCUMENT_COUNT);
+            }
+        });
+
+    METRIC_TIMER(MetricTimer::TOP_K_SELECTION);
+    const size_t result_size = std::min(candidates.size(), static_cast<size_t>(MAX_RESULT_DOCUMENT_COUNT));
+    std::partial_sort(candidates.begin(), candidates.begin() + result_size, candidates.end(), IsHigherScored);
+    std::vector<Document> result;
+    for (size_t i = 0; i < result_size; i++)
+    {
+        result.push_back({ candidates[i].document_id, scale.ToRelevance(candidates[i].score), candidates[i].rating });
+    }
+    return result;
+} // Scores are integers, so ties are exact and broken by rating and then by id. Exeptance is regulated by the filter and the function with parameters: (id, status, rating)
+template <typename Action>
+void SearchServer::ForEachAllowedPosting(std::span<const Posting> postings, const DocumentFilter& filter, const RoaringBitmap& deleted_ids, Action action)
+{
+    if (!filter.HasIdSets() && deleted_ids.IsEmpty())
+    {
+        for (const Posting& posting : postings)
+        {
+            action(posting);
+        }
+        return;
+    }
+
+    // Postings are sorted by id, so bitmap containers are looked up only once per block of 2^16 ids
+    int block = -1;
+    const RoaringBitmap::Container* allowed = nullptr;
+    const RoaringBitmap::Container* denied = nullptr;
+    const RoaringBitmap::Container* deleted = nullptr;
+    for (auto item = postings.begin(); item != postings.end();)
+    {
+        const uint32_t id = static_cast<uint32_t>(item->document_id);
+        if (HighBits(id) != block)
+        {
+            block = HighBits(id);
+            allowed = filter.allowed_ids ? filter.allowed_ids->FindContainer(HighBits(id)) : nullptr;
+            denied = filter.denied_ids ? filter.denied_ids->FindContainer(HighBits(id)) : nullptr;
+            deleted = deleted_ids.FindContainer(HighBits(id));
+            if (filter.allowed_ids && allowed == nullptr)
+            {
+                // None of the ids of this block are allowed, jump straight to the next block
+                const int64_t next_block_id = (static_cast<int64_t>(block) + 1) << 16;
+                item = std::lower_bound(item, postings.end(), next_block_id, [](const Posting& posting, int64_t id) { return posting.document_id < id; });
+                continue;
+            }
+        }
+        const uint16_t low = LowBits(id);
+        if ((allowed == nullptr || allowed->Contains(low)) && (denied == nullptr || !denied->Contains(low)) && (deleted == nullptr || !deleted->Contains(low)))
+            action(*item);
+        ++item;
+    }
+}
+template <typename Visitor>
+void SearchServer::VisitDocumentSegment(int document_id, Visitor visitor) const
+{
+    ForEachSegment([&](const auto& segment, const RoaringBitmap& deleted_ids)
+        {
+            if (segment.ContainsDocument(document_id) && !deleted_ids.Contains(static_cast<uint32_t>(document_id)))
+                visitor(segment);
+        });
+}
+template <typename Visitor>
+void SearchServer::ForEachSegment(Visitor visitor) const
+{
+    static const RoaringBitmap no_deleted_ids; // Removed documents are erased from the buffer right away
+    visitor(buffer, no_deleted_ids);
+    for (const SegmentSlot& slot : segments)
+    {
+        if (slot.segment)
+            visitor(*slot.segment, slot.deleted_ids);
+        else
+            visitor(*slot.frozen_buffer, slot.deleted_ids);
+    }
+}
\ No newline at end of file
@@ -1,6 +1,6 @@
-#pragma once
-
-#include <vector>
-#include <string>
-
+#pragma once
+
+#include <vector>
+#include <string>
+
 std::vector<std::string_view> SplitIntoWords(std::string_view text);
\ No newline at end of file
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <semaphore>
+#include <utility>
+
+// Lazy coroutine, that produces one value of T. It starts, when it is awaited, and resumes the awaiting coroutine, once it is done,
+// on whatever thread it has finished on. Use SyncWait to get the value outside of a coroutine
+template <typename T>
+class Task
+{
+public:
+    struct promise_type
+    {
+        std::optional<T> value;
+        std::exception_ptr exception;
+        std::coroutine_handle<> continuation;
+
+        Task get_return_object()
+        {
+            return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() noexcept
+        {
+            return {};
+        }
+        auto final_suspend() noexcept
+        {
+            struct FinalAwaiter
+            {
+                bool await_ready() noexcept
+                {
+                    return false;
+                }
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept
+                {
+                    const std::coroutine_handle<> continuation = handle.promise().continuation;
+                    return continuation ? continuation : std::noop_coroutine();
+                } // Symmetric transfer, so long chains of tasks don't grow the stack
+                void await_resume() noexcept {}
+            };
+            return FinalAwaiter{};
+        }
+        void return_value(T result)
+        {
+            value.emplace(std::move(result));
+        }
+        void unhandled_exception()
+        {
+            exception = std::current_exception();
+        }
+    };
+
+    Task(Task&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+    ~Task()
+    {
+        if (handle)
+            handle.destroy();
+    }
+
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+    {
+        handle.promise().continuation = awaiting;
+        return handle;
+    }
+    T await_resume()
+    {
+        if (handle.promise().exception)
+            std::rethrow_exception(handle.promise().exception);
+        return std::move(*handle.promise().value);
+    }
+
+private:
+    explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+namespace detail
+{
+    // Awaits a task on behalf of a thread, that is not a coroutine. Signals only from the final suspend point,
+    // so the waiting thread may destroy the frame right after waking up
+    struct SyncWaitCoroutine
+    {
+        struct promise_type
+        {
+            std::binary_semaphore* done = nullptr;
+
+            SyncWaitCoroutine get_return_object()
+            {
+                return SyncWaitCoroutine{ std::coroutine_handle<promise_type>::from_promise(*this) };
+            }
+            std::suspend_always initial_suspend() noexcept
+            {
+                return {};
+            }
+            auto final_suspend() noexcept
+            {
+                struct FinalAwaiter
+                {
+                    bool await_ready() noexcept
+                    {
+                        return false;
+                    }
+                    void await_suspend(std::coroutine_handle<promise_type> handle) noexcept
+                    {
+                        handle.promise().done->release();
+                    }
+                    void await_resume() noexcept {}
+                };
+                return FinalAwaiter{};
+            }
+            void return_void() {}
+            void unhandled_exception()
+            {
+                std::terminate();
+            } // Exceptions of the task are caught inside of the coroutine body
+        };
+
+        std::coroutine_handle<promise_type> handle;
+    };
+
+    template <typename T>
+    SyncWaitCoroutine AwaitTask(Task<T>& task, std::optional<T>& result, std::exception_ptr& exception)
+    {
+        try
+        {
+            result.emplace(co_await std::move(task));
+        }
+        catch (...)
+        {
+            exception = std::current_exception();
+        }
+    }
+}
+
+template <typename T>
+T SyncWait(Task<T> task)
+{
+    std::optional<T> result;
+    std::exception_ptr exception;
+    std::binary_semaphore done(0);
+    detail::SyncWaitCoroutine waiter = detail::AwaitTask(task, result, exception);
+    waiter.handle.promise().done = &done;
+    waiter.handle.resume();
+    done.acquire();
+    waiter.handle.destroy();
+
+    if (exception)
+        std::rethrow_exception(exception);
+    return std::move(*result);
+} // Blocks the calling thread, until the task is done
@@ -0,0 +1,182 @@
+#include "term_trie.h"
+
+#include <algorithm>
+#include <queue>
+
+using namespace std;
+
+namespace
+{
+    bool IsLowerLabel(char lhs, char rhs)
+    {
+        return static_cast<unsigned char>(lhs) < static_cast<unsigned char>(rhs);
+    } // Same order as std::string compares characters in
+}
+
+TermTrie::TermTrie(pmr::memory_resource* resource) : nodes(resource), word_nodes(resource), free_nodes(resource)
+{
+    nodes.emplace_back();
+}
+
+void TermTrie::Insert(string_view word, int word_id)
+{
+    int node = ROOT;
+    for (char label : word)
+    {
+        node = FindOrAddChild(node, label);
+    }
+    nodes[node].word_id = word_id;
+    nodes[node].document_count = 0;
+
+    if (word_nodes.size() <= static_cast<size_t>(word_id))
+        word_nodes.resize(word_id + 1, NO_NODE);
+    word_nodes[word_id] = node;
+}
+void TermTrie::Erase(int word_id)
+{
+    int node = word_nodes[word_id];
+    word_nodes[word_id] = NO_NODE;
+    nodes[node].word_id = NO_WORD;
+    nodes[node].document_count = 0;
+
+    // Branch, that led only to this word, is not needed anymore
+    while (node != ROOT && nodes[node].first_child == NO_NODE && nodes[node].word_id == NO_WORD)
+    {
+        const int parent = nodes[node].parent;
+        Unlink(node);
+        node = parent;
+    }
+    RecomputeBounds(node);
+}
+void TermTrie::SetDocumentCount(int word_id, int document_count)
+{
+    int node = word_nodes[word_id];
+    nodes[node].document_count = document_count;
+    // Bounds are only raised here, lowering them would take a scan of the siblings on every level
+    while (node != NO_NODE && nodes[node].max_document_count < document_count)
+    {
+        nodes[node].max_document_count = document_count;
+        node = nodes[node].parent;
+    }
+}
+
+vector<int> TermTrie::FindMostFrequent(string_view prefix, size_t max_count) const
+{
+    vector<int> result;
+    const int start = FindNode(prefix);
+    if (start == NO_NODE || max_count == 0)
+        return result;
+
+    // Words and whole subtrees are queued by their document count (exact for words, upper bound for subtrees).
+    // Word is taken, once no subtree left in the queue can have a more frequent one
+    struct Candidate
+    {
+        int document_count;
+        bool is_word; // Words go first among the equal counts, so subtrees are not opened for nothing
+        int node;
+
+        bool operator<(const Candidate& other) const
+        {
+            return document_count < other.document_count || (document_count == other.document_count && is_word < other.is_word);
+        }
+    };
+    priority_queue<Candidate> candidates;
+    if (nodes[start].max_document_count > 0)
+        candidates.push({ nodes[start].max_document_count, false, start });
+    while (!candidates.empty() && result.size() < max_count)
+    {
+        const Candidate candidate = candidates.top();
+        candidates.pop();
+        const Node& node = nodes[candidate.node];
+        if (candidate.is_word)
+        {
+            result.push_back(node.word_id);
+            continue;
+        }
+
+        if (node.word_id != NO_WORD && node.document_count > 0)
+            candidates.push({ node.document_count, true, candidate.node });
+        for (int child = node.first_child; child != NO_NODE; child = nodes[child].next_sibling)
+        {
+            if (nodes[child].max_document_count > 0)
+                candidates.push({ nodes[child].max_document_count, false, child });
+        }
+    }
+    return result;
+}
+
+int TermTrie::FindNode(string_view prefix) const
+{
+    int node = ROOT;
+    for (char label : prefix)
+    {
+        int child = nodes[node].first_child;
+        while (child != NO_NODE && IsLowerLabel(nodes[child].label, label))
+        {
+            child = nodes[child].next_sibling;
+        }
+        if (child == NO_NODE || nodes[child].label != label)
+            return NO_NODE;
+        node = child;
+    }
+    return node;
+}
+int TermTrie::FindOrAddChild(int parent, char label)
+{
+    int previous = NO_NODE;
+    int child = nodes[parent].first_child;
+    while (child != NO_NODE && IsLowerLabel(nodes[child].label, label))
+    {
+        previous = child;
+        child = nodes[child].next_sibling;
+    }
+    if (child != NO_NODE && nodes[child].label == label)
+        return child;
+
+    int node = static_cast<int>(nodes.size());
+    if (free_nodes.empty())
+        nodes.emplace_back();
+    else
+    {
+        node = free_nodes.back();
+        free_nodes.pop_back();
+        nodes[node] = Node();
+    }
+    nodes[node].parent = parent;
+    nodes[node].label = label;
+    nodes[node].next_sibling = child;
+    if (previous == NO_NODE)
+        nodes[parent].first_child = node;
+    else
+        nodes[previous].next_sibling = node;
+    return node;
+} // Keeps the siblings sorted
+void TermTrie::Unlink(int node)
+{
+    const int parent = nodes[node].parent;
+    if (nodes[parent].first_child == node)
+        nodes[parent].first_child = nodes[node].next_sibling;
+    else
+    {
+        int previous = nodes[parent].first_child;
+        while (nodes[previous].next_sibling != node)
+        {
+            previous = nodes[previous].next_sibling;
+        }
+        nodes[previous].next_sibling = nodes[node].next_sibling;
+    }
+    nodes[node] = Node();
+    free_nodes.push_back(node);
+}
+void TermTrie::RecomputeBounds(int node)
+{
+    for (; node != NO_NODE; node = nodes[node].parent)
+    {
+        int max_document_count = nodes[node].document_count;
+        for (int child = nodes[node].first_child; child != NO_NODE; child = nodes[child].next_sibling)
+        {
+            max_document_count = max(max_document_count, nodes[child].max_document_count);
+        }
+        nodes[node].max_document_count = max_document_count;
+    }
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct WordSuggestion
+{
+    std::string word; // Copied, as the word may be dropped from the dictionary, once the lock is released
+    int document_count = 0;
+};
+
+// Prefix tree over the words of the dictionary, that is updated together with it.
+// Nodes live in one array and refer to each other by index: first child and next sibling, siblings are sorted by their character.
+// Every node keeps the largest document count of the words below it, so the most frequent words of a prefix are found
+// best first, without visiting the rest of its subtree. Counts only go down in the node of the word itself, so the bounds
+// of the parents may be stale, but never too low: they are recomputed, when a word is erased
+class TermTrie
+{
+public:
+    explicit TermTrie(std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+    void Insert(std::string_view word, int word_id);
+    void Erase(int word_id); // Frees the nodes, that are left without words
+    void SetDocumentCount(int word_id, int document_count);
+
+    // Ids of the words, that start with prefix, the most frequent first; words with no documents are skipped
+    std::vector<int> FindMostFrequent(std::string_view prefix, size_t max_count) const;
+    // Walks the words in their order, but enters only the nodes, that automaton.Step(depth, label) keeps alive.
+    // Calls action(word_id, document_count, depth) for every word with documents, that the walk reaches
+    template <typename Automaton, typename Action>
+    void Intersect(Automaton& automaton, Action action) const;
+
+private:
+    static constexpr int NO_NODE = -1;
+    static constexpr int NO_WORD = -1;
+    static constexpr int ROOT = 0;
+
+    struct Node
+    {
+        int parent = NO_NODE;
+        int first_child = NO_NODE;
+        int next_sibling = NO_NODE;
+        int word_id = NO_WORD; // Word, that ends at this node
+        int document_count = 0; // ... and its document count
+        int max_document_count = 0; // Upper bound of the document counts of the node and all of its descendants
+        char label = 0;
+    };
+
+    std::pmr::vector<Node> nodes; // [node index], root first
+    std::pmr::vector<int> word_nodes; // [word id] node index
+    std::pmr::vector<int> free_nodes;
+
+    int FindNode(std::string_view prefix) const; // NO_NODE, if no word starts with prefix
+    int FindOrAddChild(int parent, char label);
+    void Unlink(int node); // Node has to be a leaf without a word
+    void RecomputeBounds(int node); // From the node up to the root
+    template <typename Automaton, typename Action>
+    void IntersectChildren(int parent, size_t depth, Automaton& automaton, Action& action) const;
+};
+
+template <typename Automaton, typename Action>
+void TermTrie::Intersect(Automaton& automaton, Action action) const
+{
+    IntersectChildren(ROOT, 0, automaton, action);
+}
+template <typename Automaton, typename Action>
+void TermTrie::IntersectChildren(int parent, size_t depth, Automaton& automaton, Action& action) const
+{
+    for (int child = nodes[parent].first_child; child != NO_NODE; child = nodes[child].next_sibling)
+    {
+        const Node& node = nodes[child];
+        if (node.max_document_count == 0 || !automaton.Step(depth, node.label))
+            continue; // Subtree has no documents or can't be accepted
+        if (node.word_id != NO_WORD && node.document_count > 0)
+            action(node.word_id, node.document_count, depth + 1);
+        IntersectChildren(child, depth + 1, automaton, action);
+    }
+}
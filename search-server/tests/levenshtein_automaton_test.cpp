@@ -0,0 +1,169 @@
+#include <algorithm>
+#include <map>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "levenshtein_automaton.h"
+#include "term_trie.h"
+#include "test_framework.h"
+
+using namespace std;
+
+namespace
+{
+    // Optimal string alignment distance: insertions, deletions, substitutions and transpositions of neighbouring characters
+    int EditDistance(string_view lhs, string_view rhs)
+    {
+        vector<vector<int>> distance(lhs.size() + 1, vector<int>(rhs.size() + 1));
+        for (size_t i = 0; i <= lhs.size(); i++)
+        {
+            for (size_t j = 0; j <= rhs.size(); j++)
+            {
+                if (i == 0 || j == 0)
+                {
+                    distance[i][j] = static_cast<int>(max(i, j));
+                    continue;
+                }
+                distance[i][j] = min({ distance[i - 1][j] + 1, distance[i][j - 1] + 1, distance[i - 1][j - 1] + (lhs[i - 1] == rhs[j - 1] ? 0 : 1) });
+                if (i > 1 && j > 1 && lhs[i - 1] == rhs[j - 2] && lhs[i - 2] == rhs[j - 1])
+                    distance[i][j] = min(distance[i][j], distance[i - 2][j - 2] + 1);
+            }
+        }
+        return distance[lhs.size()][rhs.size()];
+    }
+
+    // Distance, that the automaton reports for the input, or max_edits + 1, if it dies on the way
+    int AutomatonDistance(string_view word, string_view input, int max_edits)
+    {
+        LevenshteinAutomaton automaton(word, max_edits);
+        for (size_t depth = 0; depth < input.size(); depth++)
+        {
+            if (!automaton.Step(depth, input[depth]))
+                return max_edits + 1;
+        }
+        return automaton.GetDistance(input.size());
+    }
+
+    string RandomWord(mt19937& generator, size_t max_length)
+    {
+        uniform_int_distribution<size_t> length(0, max_length);
+        uniform_int_distribution<int> letter('a', 'c');
+        string word;
+        for (size_t i = length(generator); i > 0; i--)
+        {
+            word += static_cast<char>(letter(generator));
+        }
+        return word;
+    }
+}
+
+void TestKnownDistances()
+{
+    ASSERT_EQUAL(AutomatonDistance("kitten", "kitten", 2), 0);
+    ASSERT_EQUAL(AutomatonDistance("kitten", "sitten", 2), 1);
+    ASSERT_EQUAL(AutomatonDistance("kitten", "sittin", 2), 2);
+    ASSERT_EQUAL(AutomatonDistance("kitten", "sitting", 2), 3); // Capped at max_edits + 1
+    ASSERT_EQUAL(AutomatonDistance("kitten", "iktten", 1), 1); // Transposition
+    ASSERT_EQUAL(AutomatonDistance("kitten", "kiten", 1), 1);
+    ASSERT_EQUAL(AutomatonDistance("kitten", "kittens", 1), 1);
+    ASSERT_EQUAL(AutomatonDistance("kitten", "kittenss", 1), 2); // Longer than the word by more than max_edits
+    ASSERT_EQUAL(AutomatonDistance("", "ab", 2), 2);
+    ASSERT_EQUAL(AutomatonDistance("ab", "", 2), 2);
+    ASSERT_EQUAL(AutomatonDistance("ab", "ba", 0), 1);
+}
+
+void TestAgainstBruteForce()
+{
+    mt19937 generator(3);
+    for (int max_edits = 0; max_edits <= 3; max_edits++)
+    {
+        for (int i = 0; i < 20000; i++)
+        {
+            const string word = RandomWord(generator, 7);
+            const string input = RandomWord(generator, 9);
+            const int expected = min(EditDistance(word, input), max_edits + 1);
+            ASSERT_EQUAL(AutomatonDistance(word, input, max_edits), expected);
+        }
+    }
+}
+
+void TestDeadStatesArePrecise()
+{
+    // Step has to stay alive on every prefix of an accepted input, or TermTrie::Intersect would skip its branch
+    mt19937 generator(5);
+    for (int max_edits = 0; max_edits <= 2; max_edits++)
+    {
+        for (int i = 0; i < 20000; i++)
+        {
+            const string word = RandomWord(generator, 6);
+            const string input = RandomWord(generator, 8);
+            LevenshteinAutomaton automaton(word, max_edits);
+            for (size_t depth = 0; depth < input.size(); depth++)
+            {
+                // Some continuation of the input is within max_edits, if and only if its prefix is within max_edits of a prefix of the word
+                bool reachable = false;
+                for (size_t taken = 0; taken <= word.size() && !reachable; taken++)
+                {
+                    reachable = EditDistance(string_view(word).substr(0, taken), string_view(input).substr(0, depth + 1)) <= max_edits;
+                }
+                if (!automaton.Step(depth, input[depth]))
+                {
+                    ASSERT(!reachable);
+                    break;
+                }
+            }
+        }
+    }
+}
+
+void TestIntersectWithTrie()
+{
+    mt19937 generator(11);
+    TermTrie trie;
+    map<int, string> words;
+    for (int id = 0; id < 2000; id++)
+    {
+        const string word = RandomWord(generator, 6);
+        if (word.empty() || find_if(words.begin(), words.end(), [&word](const auto& entry) { return entry.second == word; }) != words.end())
+            continue; // Dictionary has no empty words, just as the index
+        words[id] = word;
+        trie.Insert(word, id);
+        trie.SetDocumentCount(id, 1 + id % 5);
+    }
+
+    for (int max_edits = 0; max_edits <= 2; max_edits++)
+    {
+        for (int i = 0; i < 200; i++)
+        {
+            const string query = RandomWord(generator, 6);
+            LevenshteinAutomaton automaton(query, max_edits);
+            map<int, int> found; // [word id] distance
+            trie.Intersect(automaton, [&](int word_id, int document_count, size_t depth)
+                {
+                    ASSERT_EQUAL(document_count, 1 + word_id % 5);
+                    ASSERT_EQUAL(depth, words.at(word_id).size());
+                    if (automaton.GetDistance(depth) <= max_edits)
+                        found[word_id] = automaton.GetDistance(depth);
+                });
+
+            map<int, int> expected;
+            for (const auto& [id, word] : words)
+            {
+                const int distance = EditDistance(query, word);
+                if (distance <= max_edits)
+                    expected[id] = distance;
+            }
+            ASSERT(found == expected);
+        }
+    }
+}
+
+int main()
+{
+    RUN_TEST(TestKnownDistances);
+    RUN_TEST(TestAgainstBruteForce);
+    RUN_TEST(TestDeadStatesArePrecise);
+    RUN_TEST(TestIntersectWithTrie);
+}
@@ -0,0 +1,62 @@
+#include <cstdint>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "metrics.h"
+#include "test_framework.h"
+
+using namespace std;
+
+void TestEveryBucketIsReachable()
+{
+    for (size_t bucket = 0; bucket < HISTOGRAM_OVERFLOW_BUCKET; bucket++)
+    {
+        const uint64_t upper_bound = GetHistogramBucketUpperBound(bucket);
+        ASSERT_EQUAL(GetHistogramBucket(upper_bound), bucket);
+        ASSERT_EQUAL(GetHistogramBucket(upper_bound + 1), bucket + 1);
+    }
+    ASSERT_EQUAL(GetHistogramBucketUpperBound(HISTOGRAM_OVERFLOW_BUCKET - 1), (uint64_t(1) << (HISTOGRAM_MAX_EXPONENT + 1)) - 1);
+    ASSERT_EQUAL(GetHistogramBucket(numeric_limits<uint64_t>::max()), HISTOGRAM_OVERFLOW_BUCKET);
+    ASSERT_EQUAL(GetHistogramBucketUpperBound(HISTOGRAM_OVERFLOW_BUCKET), numeric_limits<uint64_t>::max());
+}
+
+void TestPrometheusHistogram()
+{
+    ResetMetrics();
+    RecordDuration(MetricTimer::SEGMENT_MERGE, 100);
+    RecordDuration(MetricTimer::SEGMENT_MERGE, 255);
+    RecordDuration(MetricTimer::SEGMENT_MERGE, 1000);
+    RecordDuration(MetricTimer::SEGMENT_MERGE, uint64_t(1) << 42); // Overflow
+    ostringstream out;
+    PrintPrometheusMetrics(out);
+
+    const string prefix = "search_server_segment_merge_seconds_bucket{le=\"";
+    vector<pair<string, uint64_t>> buckets; // [le, cumulative count]
+    istringstream lines(out.str());
+    for (string line; getline(lines, line);)
+    {
+        if (line.compare(0, prefix.size(), prefix) != 0)
+            continue;
+        const size_t label_end = line.find('"', prefix.size());
+        buckets.push_back({ line.substr(prefix.size(), label_end - prefix.size()), stoull(line.substr(line.find(' ') + 1)) });
+    }
+
+    ASSERT_EQUAL(buckets.size(), static_cast<size_t>((HISTOGRAM_MAX_EXPONENT - PROMETHEUS_MIN_EXPONENT) / PROMETHEUS_EXPONENT_STEP + 2));
+    ASSERT(buckets[0] == make_pair("0.000000255"s, uint64_t(2))); // 2^8 - 1 ns, inclusive
+    ASSERT(buckets[1] == make_pair("0.000001023"s, uint64_t(3)));
+    ASSERT(buckets[buckets.size() - 2] == make_pair("1099.511627775"s, uint64_t(3))); // 2^40 - 1 ns
+    ASSERT(buckets.back() == make_pair("+Inf"s, uint64_t(4)));
+    for (size_t i = 1; i < buckets.size(); i++)
+    {
+        ASSERT(buckets[i - 1].second <= buckets[i].second);
+    }
+    ASSERT(out.str().find("search_server_segment_merge_seconds_count 4\n") != string::npos);
+}
+
+int main()
+{
+    RUN_TEST(TestEveryBucketIsReachable);
+    RUN_TEST(TestPrometheusHistogram);
+}
@@ -0,0 +1,177 @@
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <random>
+#include <set>
+#include <vector>
+
+#include "roaring_bitmap.h"
+#include "test_framework.h"
+
+using namespace std;
+
+namespace
+{
+    vector<uint32_t> ToVector(const set<uint32_t>& values)
+    {
+        return vector<uint32_t>(values.begin(), values.end());
+    }
+
+    void AssertSame(const RoaringBitmap& bitmap, const set<uint32_t>& expected)
+    {
+        ASSERT_EQUAL(bitmap.GetCardinality(), expected.size());
+        ASSERT_EQUAL(bitmap.IsEmpty(), expected.empty());
+        ASSERT(bitmap.ToVector() == ToVector(expected));
+    }
+
+    // Block 0 is dense (a bitset), block 1 is sparse (an array), block 2 is on the edge between them
+    set<uint32_t> RandomValues(mt19937& generator, size_t dense, size_t sparse, size_t edge)
+    {
+        set<uint32_t> values;
+        uniform_int_distribution<uint32_t> low(0, 0xFFFF);
+        while (values.size() < dense)
+        {
+            values.insert(low(generator));
+        }
+        while (values.size() < dense + sparse)
+        {
+            values.insert((1u << 16) | low(generator));
+        }
+        while (values.size() < dense + sparse + edge)
+        {
+            values.insert((2u << 16) | low(generator));
+        }
+        return values;
+    }
+}
+
+void TestAddRemoveContains()
+{
+    RoaringBitmap bitmap = { 0, 5, 65535, 65536, 1 << 20 };
+    ASSERT(bitmap.Contains(0));
+    ASSERT(bitmap.Contains(65535));
+    ASSERT(bitmap.Contains(65536));
+    ASSERT(bitmap.Contains(1 << 20));
+    ASSERT(!bitmap.Contains(1));
+    ASSERT(!bitmap.Contains(131072));
+    ASSERT(bitmap.FindContainer(2) == nullptr);
+
+    bitmap.Add(5); // Already there
+    ASSERT_EQUAL(bitmap.GetCardinality(), 5u);
+    bitmap.Remove(7); // Not there
+    bitmap.Remove(65536); // The only value of its block
+    ASSERT(bitmap.FindContainer(1) == nullptr);
+    AssertSame(bitmap, { 0, 5, 65535, 1 << 20 });
+
+    for (uint32_t value : bitmap.ToVector())
+    {
+        bitmap.Remove(value);
+    }
+    AssertSame(bitmap, {});
+}
+
+void TestContainerTransitions()
+{
+    RoaringBitmap bitmap;
+    set<uint32_t> expected;
+    for (uint32_t value = 0; value < 2 * ARRAY_CONTAINER_LIMIT; value += 2)
+    {
+        bitmap.Add(value);
+        expected.insert(value);
+    }
+    // Array container holds exactly ARRAY_CONTAINER_LIMIT values
+    ASSERT_EQUAL(bitmap.FindContainer(0)->GetCardinality(), ARRAY_CONTAINER_LIMIT);
+    AssertSame(bitmap, expected);
+
+    bitmap.Add(1); // Switches to a bitset
+    expected.insert(1);
+    ASSERT_EQUAL(bitmap.FindContainer(0)->GetMemoryUsage(), BITSET_WORDS * sizeof(uint64_t));
+    AssertSame(bitmap, expected);
+    for (uint32_t value : { 0u, 1u, 2u, 3u, 8190u, 8191u, 8192u })
+    {
+        ASSERT_EQUAL(bitmap.Contains(value), expected.count(value) > 0);
+    }
+
+    bitmap.Remove(1); // Back to an array
+    expected.erase(1);
+    ASSERT(bitmap.FindContainer(0)->GetMemoryUsage() <= ARRAY_CONTAINER_LIMIT * sizeof(uint16_t));
+    AssertSame(bitmap, expected);
+
+    // Full block and back down to one value
+    for (uint32_t value = 0; value <= 0xFFFF; value++)
+    {
+        bitmap.Add(value);
+    }
+    ASSERT_EQUAL(bitmap.GetCardinality(), 0x10000u);
+    for (uint32_t value = 1; value <= 0xFFFF; value++)
+    {
+        bitmap.Remove(value);
+    }
+    AssertSame(bitmap, { 0 });
+}
+
+void TestRandomOperations()
+{
+    mt19937 generator(42);
+    RoaringBitmap bitmap;
+    set<uint32_t> expected;
+    uniform_int_distribution<uint32_t> value(0, 3 * 0x10000 - 1);
+    for (int step = 0; step < 200000; step++)
+    {
+        const uint32_t x = value(generator);
+        // Mostly adds, so the blocks get dense enough to switch to bitsets on the way
+        if (step % 4 != 0)
+        {
+            bitmap.Add(x);
+            expected.insert(x);
+        }
+        else
+        {
+            bitmap.Remove(x);
+            expected.erase(x);
+        }
+        ASSERT_EQUAL(bitmap.Contains(x), expected.count(x) > 0);
+    }
+    AssertSame(bitmap, expected);
+}
+
+void TestSetOperations()
+{
+    mt19937 generator(7);
+    // Every pair of container kinds meets in some block
+    const vector<set<uint32_t>> samples = {
+        RandomValues(generator, 20000, 100, ARRAY_CONTAINER_LIMIT),
+        RandomValues(generator, 100, 20000, ARRAY_CONTAINER_LIMIT / 2 + 1),
+        RandomValues(generator, 30000, 30000, 0),
+        RandomValues(generator, 50, 50, 50),
+        {},
+    };
+    for (const set<uint32_t>& lhs_values : samples)
+    {
+        for (const set<uint32_t>& rhs_values : samples)
+        {
+            const RoaringBitmap lhs(lhs_values.begin(), lhs_values.end());
+            const RoaringBitmap rhs(rhs_values.begin(), rhs_values.end());
+
+            set<uint32_t> expected;
+            set_intersection(lhs_values.begin(), lhs_values.end(), rhs_values.begin(), rhs_values.end(), inserter(expected, expected.end()));
+            AssertSame(lhs & rhs, expected);
+
+            expected.clear();
+            set_union(lhs_values.begin(), lhs_values.end(), rhs_values.begin(), rhs_values.end(), inserter(expected, expected.end()));
+            AssertSame(lhs | rhs, expected);
+
+            expected.clear();
+            set_difference(lhs_values.begin(), lhs_values.end(), rhs_values.begin(), rhs_values.end(), inserter(expected, expected.end()));
+            AssertSame(AndNot(lhs, rhs), expected);
+        }
+    }
+}
+
+int main()
+{
+    RUN_TEST(TestAddRemoveContains);
+    RUN_TEST(TestContainerTransitions);
+    RUN_TEST(TestRandomOperations);
+    RUN_TEST(TestSetOperations);
+}
@@ -0,0 +1,419 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include "search_server.h"
+#include "test_framework.h"
+
+using namespace std;
+
+namespace
+{
+    struct TestDocument
+    {
+        int id;
+        string text;
+        DocumentStatus status;
+        int rating;
+    };
+
+    // Words are skewed towards the low numbers, so some of them are in most of the documents. Rating is the id, so no two documents tie
+    vector<TestDocument> GenerateDocuments(int first_id, int count, unsigned seed)
+    {
+        mt19937 generator(seed);
+        uniform_int_distribution<int> word(0, 299);
+        uniform_int_distribution<int> length(3, 12);
+        vector<TestDocument> result;
+        for (int id = first_id; id < first_id + count; id++)
+        {
+            string text;
+            for (int i = length(generator); i > 0; i--)
+            {
+                text += 'w';
+                text += to_string(min(word(generator), word(generator)));
+                text += ' ';
+            }
+            result.push_back({ id, text, id % 10 == 0 ? DocumentStatus::IRRELEVANT : DocumentStatus::ACTUAL, id });
+        }
+        return result;
+    }
+    void AddDocuments(SearchServer& server, const vector<TestDocument>& documents)
+    {
+        for (const TestDocument& document : documents)
+        {
+            server.AddDocument(document.id, document.text, document.status, { document.rating });
+        }
+    }
+
+    void AssertSameDocuments(const vector<Document>& lhs, const vector<Document>& rhs)
+    {
+        ASSERT_EQUAL(lhs.size(), rhs.size());
+        for (size_t i = 0; i < lhs.size(); i++)
+        {
+            ASSERT_EQUAL(lhs[i].id, rhs[i].id);
+            ASSERT(abs(lhs[i].relevance - rhs[i].relevance) < EPSILON);
+            ASSERT_EQUAL(lhs[i].rating, rhs[i].rating);
+        }
+    }
+
+    const vector<string> TEST_QUERIES = { "w0", "w1 w2", "w5 w17 -w0", "w100 w200 w299", "w3 -w1 -w2", "w42 w43 w44 w45", "w7*", "w12~", "missing" };
+
+    void AssertSameSearchResults(const SearchServer& server, const SearchServer& expected)
+    {
+        ASSERT_EQUAL(server.GetDocumentCount(), expected.GetDocumentCount());
+        for (const string& query : TEST_QUERIES)
+        {
+            AssertSameDocuments(server.FindTopDocuments(query), expected.FindTopDocuments(query));
+            AssertSameDocuments(server.FindTopDocuments(execution::par, query), expected.FindTopDocuments(query));
+            AssertSameDocuments(server.FindTopDocuments(adaptive_policy, query), expected.FindTopDocuments(query));
+            AssertSameDocuments(server.FindTopDocuments(query, DocumentStatus::IRRELEVANT), expected.FindTopDocuments(query, DocumentStatus::IRRELEVANT));
+        }
+    }
+
+    // Text of filler words f0, f1, ... with the given word in place of the filler at its position
+    string MakeText(size_t word_count, size_t position, const string& word)
+    {
+        string text;
+        for (size_t i = 0; i < word_count; i++)
+        {
+            if (i > 0)
+                text += ' ';
+            if (i == position)
+            {
+                text += word;
+            }
+            else
+            {
+                text += 'f';
+                text += to_string(i);
+            }
+        }
+        return text;
+    }
+    size_t CountWords(string_view text)
+    {
+        return text.empty() ? 0 : static_cast<size_t>(count(text.begin(), text.end(), ' ')) + 1;
+    } // Words are separated by single spaces
+
+    vector<string_view> GetHighlightedWords(const DocumentSnippet& snippet)
+    {
+        vector<string_view> result;
+        for (const auto& [begin, end] : snippet.highlights)
+        {
+            ASSERT(begin < end && end <= snippet.text.size());
+            result.push_back(snippet.text.substr(begin, end - begin));
+        }
+        return result;
+    }
+}
+
+void TestForwardIndexRebuildKeepsStopWordDocuments()
+{
+    SearchServer server("and in"s);
+    server.AddDocument(1, "cat in the city", DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(2, "and in", DocumentStatus::BANNED, { 2 }); // No postings at all
+
+    server.SetMemoryBudget(1);
+    ASSERT(!server.HasForwardIndex());
+    server.SetMemoryBudget(UNLIMITED_MEMORY_BUDGET);
+    ASSERT(server.HasForwardIndex());
+
+    const auto [words, status] = server.MatchDocument("cat"s, 2);
+    ASSERT(words.empty());
+    ASSERT(status == DocumentStatus::BANNED);
+    ASSERT(server.GetWordIds(2).empty());
+
+    server.RemoveDocument(2);
+    ASSERT_EQUAL(server.GetDocumentCount(), 1);
+    server.AddDocument(2, "cat and dog", DocumentStatus::ACTUAL, { 3 });
+    ASSERT_EQUAL(get<0>(server.MatchDocument("cat dog"s, 2)).size(), 2u);
+}
+
+void TestMemoryBudgetRebuildsOnlyWhatFits()
+{
+    SearchServer server("and in"s);
+    for (int id = 0; id < 200; id++)
+    {
+        server.AddDocument(id, "word" + to_string(id % 17) + " word" + to_string(id % 5) + " common text", DocumentStatus::ACTUAL, { id });
+    }
+    const size_t forward_index_bytes = server.GetMemoryStats().forward_index.bytes;
+    ASSERT(forward_index_bytes > 0);
+
+    server.SetMemoryBudget(1);
+    ASSERT(!server.HasForwardIndex());
+    const size_t bytes_without_forward_index = server.GetMemoryStats().GetTotal().bytes;
+    ASSERT_EQUAL(server.GetMemoryStats().forward_index.bytes, 0u);
+
+    // Index fits, but not together with the forward index: it is not rebuilt just to be dropped again
+    server.SetMemoryBudget(bytes_without_forward_index + 1);
+    ASSERT(!server.HasForwardIndex());
+    ASSERT_EQUAL(server.GetMemoryStats().forward_index.bytes, 0u);
+
+    server.SetMemoryBudget(bytes_without_forward_index + 2 * forward_index_bytes);
+    ASSERT(server.HasForwardIndex());
+    ASSERT_EQUAL(server.GetMemoryStats().forward_index.bytes, forward_index_bytes);
+}
+
+void TestSegmentsKeepResultsThroughMerges()
+{
+    // Three buffers are frozen and sealed in the background, the fourth one is still mutable
+    const vector<TestDocument> documents = GenerateDocuments(0, 3 * static_cast<int>(SEGMENT_BUFFER_SIZE) + 300, 1);
+    SearchServer server(""s);
+    AddDocuments(server, documents);
+    server.AddDocument(100000, "ghostword w1", DocumentStatus::ACTUAL, { 0 });
+
+    // Removed documents of the frozen and sealed segments are only marked, the ones of the buffer are erased
+    vector<TestDocument> survivors;
+    for (const TestDocument& document : documents)
+    {
+        if (document.id % 7 == 3)
+            server.RemoveDocument(document.id);
+        else
+            survivors.push_back(document);
+    }
+    server.RemoveDocument(100000);
+    SearchServer expected(""s);
+    AddDocuments(expected, survivors);
+    AssertSameSearchResults(server, expected);
+    ASSERT(server.Suggest("ghost", 1).empty());
+
+    // Compaction rewrites every segment with removed documents and purges their postings
+    const size_t segment_bytes = server.GetMemoryStats().segments.bytes;
+    server.CompactRemovedDocuments();
+    ASSERT(server.GetMemoryStats().segments.bytes < segment_bytes);
+    AssertSameSearchResults(server, expected);
+
+    // Enough sealed segments of one tier for a background merge, while some of them have removed documents
+#ifndef SEARCH_SERVER_DISABLE_METRICS
+    const auto merge_count = []() { return GetMetricsSnapshot()[MetricTimer::SEGMENT_MERGE].count; };
+    const uint64_t merges_before = merge_count();
+#endif
+    const vector<TestDocument> more_documents = GenerateDocuments(static_cast<int>(documents.size()), static_cast<int>(SEGMENT_MERGE_FACTOR * SEGMENT_BUFFER_SIZE), 2);
+    AddDocuments(server, more_documents);
+    AddDocuments(expected, more_documents);
+    for (const TestDocument& document : more_documents)
+    {
+        if (document.id % 11 == 5)
+        {
+            server.RemoveDocument(document.id);
+            expected.RemoveDocument(document.id);
+        }
+    }
+    AssertSameSearchResults(server, expected);
+#ifndef SEARCH_SERVER_DISABLE_METRICS
+    // Results have to be the same at any moment, the wait only makes sure, that the merge has run before the last checks
+    for (int i = 0; i < 1000 && merge_count() == merges_before; i++)
+    {
+        this_thread::sleep_for(10ms);
+    }
+    ASSERT(merge_count() > merges_before);
+#endif
+    AssertSameSearchResults(server, expected);
+    server.CompactRemovedDocuments();
+    AssertSameSearchResults(server, expected);
+}
+
+void TestAdaptivePolicyParsesQueryOnce()
+{
+    SearchServer server(""s, ThreadPoolOptions{ 4 });
+    AddDocuments(server, GenerateDocuments(0, 2000, 3));
+    for (const string& query : TEST_QUERIES)
+    {
+#ifndef SEARCH_SERVER_DISABLE_METRICS
+        const uint64_t parses_before = GetMetricsSnapshot()[MetricTimer::QUERY_PARSE].count;
+#endif
+        const vector<Document> result = server.FindTopDocuments(adaptive_policy, query);
+#ifndef SEARCH_SERVER_DISABLE_METRICS
+        ASSERT_EQUAL(GetMetricsSnapshot()[MetricTimer::QUERY_PARSE].count, parses_before + 1);
+#endif
+        AssertSameDocuments(result, server.FindTopDocuments(query));
+    }
+}
+
+void TestCostModelIsCalibratedOncePerPoolSize()
+{
+    using Clock = chrono::steady_clock;
+    {
+        SearchServer first(""s, ThreadPoolOptions{ 3 });
+    }
+    // Second server with a pool of the same size takes the coefficients of the first one instead of measuring again
+    const Clock::time_point start = Clock::now();
+    SearchServer second(""s, ThreadPoolOptions{ 3 });
+    ASSERT(Clock::now() - start < 20ms);
+    second.AddDocument(1, "cat", DocumentStatus::ACTUAL, { 1 });
+    ASSERT_EQUAL(second.FindTopDocuments(adaptive_policy, "cat"s).size(), 1u);
+}
+
+void TestRatingFilterMatchesUnfilteredPath()
+{
+    // Rating is the id, so the bounds cut through the rating envelopes of a sealed segment and of the buffer
+    const vector<TestDocument> documents = GenerateDocuments(0, 2 * static_cast<int>(SEGMENT_BUFFER_SIZE) + 300, 4);
+    SearchServer server(""s);
+    AddDocuments(server, documents);
+    const int min_rating = 700;
+    const int max_rating = 2200;
+    auto allowed_ids = make_shared<RoaringBitmap>();
+    for (const TestDocument& document : documents)
+    {
+        if (document.rating >= min_rating && document.rating <= max_rating)
+            allowed_ids->Add(static_cast<uint32_t>(document.id));
+    }
+    // Id allow-list and the predicate don't use the ratings of postings, so they are the reference for the rating filter
+    const DocumentFilter rating_filter = DocumentFilter::ForStatus(DocumentStatus::ACTUAL).WithRating(min_rating, max_rating);
+    const DocumentFilter id_filter = DocumentFilter::ForStatus(DocumentStatus::ACTUAL).AllowIds(allowed_ids);
+    const auto predicate = [&](int document_id, DocumentStatus status, int rating)
+    {
+        return status == DocumentStatus::ACTUAL && rating >= min_rating && rating <= max_rating && rating == document_id;
+    };
+    for (const string& query : TEST_QUERIES)
+    {
+        const vector<Document> expected = server.FindTopDocuments(query, id_filter);
+        for (const Document& document : expected)
+        {
+            ASSERT(document.rating >= min_rating && document.rating <= max_rating);
+        }
+        AssertSameDocuments(server.FindTopDocuments(query, rating_filter), expected);
+        AssertSameDocuments(server.FindTopDocuments(query, predicate), expected);
+        AssertSameDocuments(server.FindTopDocuments(execution::par, query, rating_filter), expected);
+        AssertSameDocuments(server.FindTopDocuments(execution::par, query, predicate), expected);
+        AssertSameDocuments(server.FindTopDocuments(adaptive_policy, query, rating_filter), expected);
+        AssertSameDocuments(server.FindTopDocuments(quantized_policy, query, rating_filter), server.FindTopDocuments(quantized_policy, query, id_filter));
+    }
+}
+
+void TestAsyncSearchWithExpiredDeadline()
+{
+    SearchServer server(""s, ThreadPoolOptions{ 2 });
+    AddDocuments(server, GenerateDocuments(0, 2 * static_cast<int>(SEGMENT_BUFFER_SIZE) + 300, 5));
+    // Deadline is checked before every segment, so none of them is started and the partial result is empty
+    const auto expired = SearchDeadline::Clock::now() - 1s;
+    for (const string& query : TEST_QUERIES)
+    {
+        const TopDocumentsResult result = SyncWait(server.FindTopDocumentsAsync(query, expired));
+        ASSERT(result.truncated);
+        ASSERT(result.documents.empty());
+    }
+    // Stop request cuts the search short the same way, however far the deadline is
+    stop_source stop;
+    stop.request_stop();
+    const TopDocumentsResult stopped = SyncWait(server.FindTopDocumentsAsync("w0 w1"s, SearchDeadline::Clock::now() + 1h, stop.get_token()));
+    ASSERT(stopped.truncated);
+    ASSERT(stopped.documents.empty());
+}
+
+void TestAsyncSearchWithinDeadlineMatchesSync()
+{
+    SearchServer server(""s, ThreadPoolOptions{ 2 });
+    AddDocuments(server, GenerateDocuments(0, 2 * static_cast<int>(SEGMENT_BUFFER_SIZE) + 300, 6));
+    const auto generous = SearchDeadline::Clock::now() + 1h;
+    for (const string& query : TEST_QUERIES)
+    {
+        const TopDocumentsResult result = SyncWait(server.FindTopDocumentsAsync(query, generous));
+        ASSERT(!result.truncated);
+        AssertSameDocuments(result.documents, server.FindTopDocuments(query));
+
+        const DocumentFilter filter = DocumentFilter::ForStatus(DocumentStatus::IRRELEVANT).WithRating(100, 2000);
+        const TopDocumentsResult filtered = SyncWait(server.FindTopDocumentsAsync(query, filter, generous));
+        ASSERT(!filtered.truncated);
+        AssertSameDocuments(filtered.documents, server.FindTopDocuments(query, filter));
+    }
+}
+
+void TestSnippetWindowBoundaries()
+{
+    SearchServer server(""s);
+    server.AddDocument(1, MakeText(40, 0, "cat"), DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(2, MakeText(40, 39, "dog"), DocumentStatus::ACTUAL, { 2 });
+    server.AddDocument(3, MakeText(40, 20, "bird"), DocumentStatus::ACTUAL, { 3 });
+    server.AddDocument(4, "short cat text", DocumentStatus::ACTUAL, { 4 });
+
+    // Window can't start before the first word of the text
+    vector<DocumentSnippet> snippets = server.FindTopDocumentsWithSnippets("cat"s);
+    ASSERT_EQUAL(snippets.size(), 2u);
+    const DocumentSnippet& at_start = snippets[0].document.id == 1 ? snippets[0] : snippets[1];
+    ASSERT_EQUAL(at_start.text, MakeText(SNIPPET_WORD_COUNT, 0, "cat"));
+    ASSERT_EQUAL(at_start.highlights.size(), 1u);
+    ASSERT_EQUAL(at_start.highlights[0].first, 0u);
+    ASSERT_EQUAL(at_start.highlights[0].second, 3u);
+
+    // Text shorter than the window is the whole snippet
+    const DocumentSnippet& short_text = snippets[0].document.id == 4 ? snippets[0] : snippets[1];
+    ASSERT_EQUAL(short_text.text, "short cat text"s);
+    ASSERT_EQUAL(GetHighlightedWords(short_text), vector<string_view>{ "cat"sv });
+
+    // Nor end after the last one
+    snippets = server.FindTopDocumentsWithSnippets("dog"s);
+    ASSERT_EQUAL(snippets.size(), 1u);
+    ASSERT_EQUAL(CountWords(snippets[0].text), SNIPPET_WORD_COUNT);
+    ASSERT(snippets[0].text.ends_with(" f38 dog"));
+    ASSERT_EQUAL(snippets[0].highlights.size(), 1u);
+    ASSERT_EQUAL(snippets[0].highlights[0].second, snippets[0].text.size());
+
+    // Match far from both ends is put into the middle of the window
+    snippets = server.FindTopDocumentsWithSnippets("bird"s);
+    ASSERT_EQUAL(snippets.size(), 1u);
+    ASSERT_EQUAL(CountWords(snippets[0].text), SNIPPET_WORD_COUNT);
+    ASSERT(snippets[0].text.starts_with("f9 "));
+    ASSERT(snippets[0].text.ends_with(" f32"));
+    ASSERT_EQUAL(GetHighlightedWords(snippets[0]), vector<string_view>{ "bird"sv });
+}
+
+void TestSnippetHighlights()
+{
+    SearchServer server("the in"s);
+    server.AddDocument(1, "the cat sat in the hat near the cat and a dog", DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(2, "the dog in the fog", DocumentStatus::ACTUAL, { 2 });
+    server.AddDocument(3, "a cat in the snow", DocumentStatus::ACTUAL, { 3 });
+
+    // Every occurrence of a query word is highlighted, offsets point at its bytes in the snippet; stop words are never highlighted
+    vector<DocumentSnippet> snippets = server.FindTopDocumentsWithSnippets("the cat hat"s);
+    ASSERT_EQUAL(snippets.size(), 2u);
+    for (const DocumentSnippet& snippet : snippets)
+    {
+        for (string_view word : GetHighlightedWords(snippet))
+        {
+            ASSERT(word == "cat"sv || word == "hat"sv);
+        }
+    }
+    const DocumentSnippet& first = snippets[0].document.id == 1 ? snippets[0] : snippets[1];
+    ASSERT_EQUAL(first.text, "the cat sat in the hat near the cat and a dog"s);
+    ASSERT_EQUAL(GetHighlightedWords(first), (vector<string_view>{ "cat"sv, "hat"sv, "cat"sv }));
+    ASSERT_EQUAL(first.highlights[0].first, 4u);
+    ASSERT_EQUAL(first.highlights[1].first, 19u);
+    ASSERT_EQUAL(first.highlights[2].first, 32u);
+
+    // Query of stop words only matches nothing
+    ASSERT(server.FindTopDocumentsWithSnippets("the in"s).empty());
+
+    // Documents with minus words are left out, and minus words are not highlighted in the rest
+    snippets = server.FindTopDocumentsWithSnippets("cat -dog"s);
+    ASSERT_EQUAL(snippets.size(), 1u);
+    ASSERT_EQUAL(snippets[0].document.id, 3);
+    ASSERT_EQUAL(GetHighlightedWords(snippets[0]), vector<string_view>{ "cat"sv });
+    snippets = server.FindTopDocumentsWithSnippets("fog -cat"s);
+    ASSERT_EQUAL(snippets.size(), 1u);
+    ASSERT_EQUAL(snippets[0].document.id, 2);
+    ASSERT_EQUAL(GetHighlightedWords(snippets[0]), vector<string_view>{ "fog"sv });
+}
+
+int main()
+{
+    RUN_TEST(TestForwardIndexRebuildKeepsStopWordDocuments);
+    RUN_TEST(TestMemoryBudgetRebuildsOnlyWhatFits);
+    RUN_TEST(TestSegmentsKeepResultsThroughMerges);
+    RUN_TEST(TestAdaptivePolicyParsesQueryOnce);
+    RUN_TEST(TestCostModelIsCalibratedOncePerPoolSize);
+    RUN_TEST(TestRatingFilterMatchesUnfilteredPath);
+    RUN_TEST(TestAsyncSearchWithExpiredDeadline);
+    RUN_TEST(TestAsyncSearchWithinDeadlineMatchesSync);
+    RUN_TEST(TestSnippetWindowBoundaries);
+    RUN_TEST(TestSnippetHighlights);
+}
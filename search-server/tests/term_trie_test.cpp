@@ -0,0 +1,173 @@
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "term_trie.h"
+#include "test_framework.h"
+
+using namespace std;
+
+namespace
+{
+    struct TestWord
+    {
+        string text;
+        int document_count = 0;
+    };
+
+    // Checks FindMostFrequent against a scan of all the words: the same words, the most frequent first, ties in any order
+    void AssertMostFrequent(const TermTrie& trie, const map<int, TestWord>& words, const string& prefix, size_t max_count)
+    {
+        vector<int> expected_counts;
+        for (const auto& [id, word] : words)
+        {
+            if (word.document_count > 0 && word.text.compare(0, prefix.size(), prefix) == 0)
+                expected_counts.push_back(word.document_count);
+        }
+        sort(expected_counts.begin(), expected_counts.end(), greater<int>());
+        if (expected_counts.size() > max_count)
+            expected_counts.erase(expected_counts.begin() + max_count, expected_counts.end());
+
+        const vector<int> result = trie.FindMostFrequent(prefix, max_count);
+        vector<int> counts;
+        for (int id : result)
+        {
+            const TestWord& word = words.at(id);
+            ASSERT(word.text.compare(0, prefix.size(), prefix) == 0);
+            counts.push_back(word.document_count);
+        }
+        ASSERT(counts == expected_counts);
+        vector<int> unique_ids = result;
+        sort(unique_ids.begin(), unique_ids.end());
+        ASSERT(adjacent_find(unique_ids.begin(), unique_ids.end()) == unique_ids.end());
+    }
+}
+
+void TestPrefixEnumeration()
+{
+    TermTrie trie;
+    const map<int, TestWord> words = {
+        { 0, { "cat", 5 } },
+        { 1, { "car", 9 } },
+        { 2, { "cart", 2 } },
+        { 3, { "care", 9 } },
+        { 4, { "dog", 7 } },
+        { 5, { "ca", 1 } },
+        { 6, { "cargo", 0 } }, // No documents, never suggested
+    };
+    for (const auto& [id, word] : words)
+    {
+        trie.Insert(word.text, id);
+        trie.SetDocumentCount(id, word.document_count);
+    }
+
+    ASSERT(trie.FindMostFrequent("ca", 2).size() == 2);
+    ASSERT_EQUAL(trie.FindMostFrequent("cat", 10), vector<int>{ 0 });
+    ASSERT_EQUAL(trie.FindMostFrequent("carg", 10), vector<int>{});
+    ASSERT_EQUAL(trie.FindMostFrequent("x", 10), vector<int>{});
+    ASSERT_EQUAL(trie.FindMostFrequent("c", 0), vector<int>{});
+    ASSERT_EQUAL(trie.FindMostFrequent("", 1).size(), 1u);
+    for (const string prefix : { "", "c", "ca", "car", "cart", "d", "dogs" })
+    {
+        for (size_t max_count = 0; max_count <= words.size() + 1; max_count++)
+        {
+            AssertMostFrequent(trie, words, prefix, max_count);
+        }
+    }
+}
+
+void TestUpdatesAndErase()
+{
+    TermTrie trie;
+    map<int, TestWord> words = {
+        { 0, { "alpha", 10 } },
+        { 1, { "alps", 3 } },
+        { 2, { "al", 1 } },
+        { 3, { "beta", 4 } },
+    };
+    for (const auto& [id, word] : words)
+    {
+        trie.Insert(word.text, id);
+        trie.SetDocumentCount(id, word.document_count);
+    }
+
+    // Bounds of the parents stay at 10, but the order has to follow the new count
+    words[0].document_count = 2;
+    trie.SetDocumentCount(0, 2);
+    ASSERT_EQUAL(trie.FindMostFrequent("al", 3), (vector<int>{ 1, 0, 2 }));
+    AssertMostFrequent(trie, words, "al", 1);
+
+    words[1].document_count = 0;
+    trie.SetDocumentCount(1, 0);
+    ASSERT_EQUAL(trie.FindMostFrequent("alp", 3), vector<int>{ 0 });
+
+    trie.Erase(0);
+    words.erase(0);
+    ASSERT_EQUAL(trie.FindMostFrequent("alph", 3), vector<int>{});
+    ASSERT_EQUAL(trie.FindMostFrequent("al", 3), vector<int>{ 2 });
+
+    // Freed nodes are reused by the next words
+    words[4] = { "alpine", 6 };
+    trie.Insert("alpine", 4);
+    trie.SetDocumentCount(4, 6);
+    ASSERT_EQUAL(trie.FindMostFrequent("alp", 3), vector<int>{ 4 });
+    AssertMostFrequent(trie, words, "", 10);
+}
+
+void TestRandomDictionary()
+{
+    mt19937 generator(17);
+    uniform_int_distribution<int> length(1, 6);
+    uniform_int_distribution<int> letter('a', 'd');
+    uniform_int_distribution<int> count(0, 20);
+
+    TermTrie trie;
+    map<int, TestWord> words;
+    map<string, int> ids;
+    int next_id = 0;
+    for (int step = 0; step < 3000; step++)
+    {
+        string text;
+        for (int i = length(generator); i > 0; i--)
+        {
+            text += static_cast<char>(letter(generator));
+        }
+        const auto it = ids.find(text);
+        if (it == ids.end())
+        {
+            ids[text] = next_id;
+            words[next_id] = { text, 0 };
+            trie.Insert(text, next_id++);
+        }
+        else if (step % 3 == 0)
+        {
+            trie.Erase(it->second);
+            words.erase(it->second);
+            ids.erase(it);
+            continue;
+        }
+        const int id = ids.at(text);
+        words[id].document_count = count(generator);
+        trie.SetDocumentCount(id, words[id].document_count);
+
+        if (step % 50 == 0)
+        {
+            for (const string& prefix : vector<string>{ "", "a", "b", "ab", "dd", "cab", text.substr(0, 2) })
+            {
+                AssertMostFrequent(trie, words, prefix, 1);
+                AssertMostFrequent(trie, words, prefix, 7);
+                AssertMostFrequent(trie, words, prefix, words.size());
+            }
+        }
+    }
+}
+
+int main()
+{
+    RUN_TEST(TestPrefixEnumeration);
+    RUN_TEST(TestUpdatesAndErase);
+    RUN_TEST(TestRandomDictionary);
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+// Checks stay on in Release builds, unlike assert
+#define ASSERT(expr) AssertImpl(static_cast<bool>(expr), #expr, __FILE__, __LINE__)
+#define ASSERT_EQUAL(lhs, rhs) AssertImpl((lhs) == (rhs), #lhs " == " #rhs, __FILE__, __LINE__)
+#define RUN_TEST(func) RunTestImpl(func, #func)
+
+inline void AssertImpl(bool value, const std::string& expr, const std::string& file, unsigned line)
+{
+    if (value)
+        return;
+    std::cerr << file << "(" << line << "): ASSERT(" << expr << ") failed" << std::endl;
+    std::abort();
+}
+
+template <typename TestFunc>
+void RunTestImpl(TestFunc func, const std::string& name)
+{
+    func();
+    std::cerr << name << " OK" << std::endl;
+}
@@ -0,0 +1,131 @@
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "test_framework.h"
+#include "thread_pool.h"
+
+using namespace std;
+using namespace std::chrono;
+
+void TestShutdownRunsQueuedTasks()
+{
+    atomic<bool> released = false;
+    atomic<int> done = 0;
+    {
+        // Releases the first task only while the pool is being destroyed, so the rest are still queued then
+        jthread releaser([&released]()
+            {
+                this_thread::sleep_for(50ms);
+                released = true;
+                released.notify_all();
+            });
+        ThreadPool pool(ThreadPoolOptions{ 1 });
+        pool.Submit([&released]() { released.wait(false); });
+        for (int i = 0; i < 100; i++)
+        {
+            pool.Submit([&pool, &done]()
+                {
+                    done++;
+                    pool.Submit([&done]() { done++; }); // Tasks, queued by the tasks, are run too
+                });
+        }
+    }
+    ASSERT(released);
+    ASSERT_EQUAL(done, 200);
+
+    ThreadPool unused; // No task, no threads to join
+}
+
+void TestParallelForCallsEveryIndex()
+{
+    ThreadPool pool(ThreadPoolOptions{ 4 });
+    pool.ParallelFor(0, [](size_t) { ASSERT(false); });
+
+    vector<atomic<int>> calls(1000);
+    pool.ParallelFor(calls.size(), [&calls](size_t i) { calls[i]++; });
+    for (const atomic<int>& count : calls)
+    {
+        ASSERT_EQUAL(count, 1);
+    }
+
+    // Nested loops take part in the outer ones instead of waiting for them
+    atomic<long> sum = 0;
+    pool.ParallelFor(100, [&pool, &sum](size_t i)
+        {
+            pool.ParallelFor(100, [i, &sum](size_t j) { sum += static_cast<long>(i * 100 + j); });
+        });
+    ASSERT_EQUAL(sum, 10000L * 9999 / 2);
+
+    // Loops from many outside threads at once
+    atomic<int> count = 0;
+    {
+        vector<jthread> threads;
+        for (int t = 0; t < 8; t++)
+        {
+            threads.emplace_back([&pool, &count]()
+                {
+                    for (int k = 0; k < 50; k++)
+                    {
+                        pool.ParallelFor(10, [&count](size_t) { count++; });
+                    }
+                });
+        }
+    }
+    ASSERT_EQUAL(count, 8 * 50 * 10);
+}
+
+void TestParallelForRethrows()
+{
+    ThreadPool pool(ThreadPoolOptions{ 4 });
+    atomic<int> calls = 0;
+    bool thrown = false;
+    try
+    {
+        pool.ParallelFor(100, [&calls](size_t i)
+            {
+                calls++;
+                if (i % 10 == 3)
+                    throw out_of_range("index " + to_string(i));
+            });
+    }
+    catch (const out_of_range&)
+    {
+        thrown = true;
+    }
+    ASSERT(thrown);
+    ASSERT_EQUAL(calls, 100); // The other calls are not cancelled, the loop returns once all of them are done
+
+    // Exception of a nested loop goes through the outer one
+    thrown = false;
+    try
+    {
+        pool.ParallelFor(8, [&pool](size_t i)
+            {
+                pool.ParallelFor(8, [i](size_t j)
+                    {
+                        if (i == 5 && j == 2)
+                            throw invalid_argument("nested");
+                    });
+            });
+    }
+    catch (const invalid_argument&)
+    {
+        thrown = true;
+    }
+    ASSERT(thrown);
+
+    // Pool stays usable
+    atomic<int> count = 0;
+    pool.ParallelFor(10, [&count](size_t) { count++; });
+    ASSERT_EQUAL(count, 10);
+}
+
+int main()
+{
+    RUN_TEST(TestShutdownRunsQueuedTasks);
+    RUN_TEST(TestParallelForCallsEveryIndex);
+    RUN_TEST(TestParallelForRethrows);
+}
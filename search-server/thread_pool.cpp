@@ -0,0 +1,287 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cctype>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+using namespace std;
+
+namespace
+{
+    thread_local const ThreadPool* current_pool = nullptr; // Pool of the calling worker thread, nullptr outside of any pool
+    thread_local size_t current_worker = 0;
+
+    vector<int> ParseCpuList(const string& text)
+    {
+        vector<int> cpus;
+        stringstream stream(text);
+        string range;
+        while (getline(stream, range, ','))
+        {
+            if (range.empty() || !isdigit(static_cast<unsigned char>(range[0])))
+                continue;
+            const size_t dash = range.find('-');
+            const int first = stoi(range.substr(0, dash));
+            const int last = dash == string::npos ? first : stoi(range.substr(dash + 1));
+            for (int cpu = first; cpu <= last; cpu++)
+            {
+                cpus.push_back(cpu);
+            }
+        }
+        return cpus;
+    } // "0-3,8-11", as in /sys/devices/system/node/node*/cpulist
+
+    vector<vector<int>> DetectNumaNodes()
+    {
+        vector<vector<int>> nodes; // [node] -> CPUs, that the process may run on
+#ifdef __linux__
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        const bool has_affinity = sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+
+        map<int, vector<int>> numbered_nodes;
+        error_code error;
+        for (filesystem::directory_iterator it("/sys/devices/system/node", error), end; !error && it != end; it.increment(error))
+        {
+            const string name = it->path().filename().string();
+            if (name.size() <= 4 || name.compare(0, 4, "node") != 0 || !isdigit(static_cast<unsigned char>(name[4])))
+                continue;
+            ifstream file(it->path() / "cpulist");
+            string text;
+            getline(file, text);
+            vector<int> cpus;
+            for (int cpu : ParseCpuList(text))
+            {
+                if (cpu < CPU_SETSIZE && (!has_affinity || CPU_ISSET(cpu, &allowed)))
+                    cpus.push_back(cpu);
+            }
+            if (!cpus.empty())
+                numbered_nodes[stoi(name.substr(4))] = move(cpus);
+        }
+        for (auto& [node, cpus] : numbered_nodes)
+        {
+            nodes.push_back(move(cpus));
+        }
+#endif
+        if (nodes.empty())
+        {
+            // No topology is known: one node of all the CPUs
+            nodes.emplace_back();
+            for (unsigned cpu = 0; cpu < max(thread::hardware_concurrency(), 1u); cpu++)
+            {
+                nodes.back().push_back(static_cast<int>(cpu));
+            }
+        }
+        return nodes;
+    }
+
+    void PinCurrentThread(int cpu)
+    {
+#ifdef __linux__
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(cpu, &cpus);
+        sched_setaffinity(0, sizeof(cpus), &cpus); // Worker keeps running unpinned, if the CPU is not allowed
+#endif
+    } // Pinning is supported on Linux only, elsewhere workers are left to the OS scheduler
+}
+
+ThreadPool::ThreadPool(ThreadPoolOptions options) : options(options)
+{
+    this->options.thread_count = max<size_t>(options.thread_count, 1);
+}
+ThreadPool::~ThreadPool()
+{
+    for (const unique_ptr<Worker>& worker : workers)
+    {
+        worker->thread.request_stop();
+    }
+    condition.notify_all();
+    // Workers empty all the queues before they exit. All of them are joined, before any deque is destroyed, as the others steal from it
+    for (const unique_ptr<Worker>& worker : workers)
+    {
+        worker->thread.join();
+    }
+}
+
+void ThreadPool::Submit(function<void()> task)
+{
+    call_once(start_flag, [this]() { StartWorkers(); });
+    Push(move(task));
+}
+void ThreadPool::ParallelFor(size_t count, const function<void(size_t)>& body)
+{
+    if (count == 0)
+        return;
+
+    struct LoopState
+    {
+        atomic<size_t> next = 0;
+        atomic<size_t> done = 0;
+        std::mutex exception_mutex; // std::, as the member of the pool hides the type
+        exception_ptr exception;
+    };
+    const shared_ptr<LoopState> state = make_shared<LoopState>();
+    // Indices are taken one by one, so a slow one does not hold the others back. Helpers, that start after all indices are taken,
+    // return without touching body, so they may outlive this call
+    const auto run = [state, count, &body]()
+    {
+        for (size_t i = state->next++; i < count; i = state->next++)
+        {
+            try
+            {
+                body(i);
+            }
+            catch (...)
+            {
+                lock_guard lock(state->exception_mutex);
+                if (!state->exception)
+                    state->exception = current_exception();
+            }
+            if (++state->done == count)
+                state->done.notify_all();
+        }
+    };
+
+    const size_t helper_count = min(count - 1, options.thread_count);
+    for (size_t i = 0; i < helper_count; i++)
+    {
+        Submit(run);
+    }
+    run();
+    for (size_t done = state->done; done < count; done = state->done)
+    {
+        state->done.wait(done);
+    }
+
+    if (state->exception)
+        rethrow_exception(state->exception);
+}
+size_t ThreadPool::GetThreadCount() const
+{
+    return options.thread_count;
+}
+
+void ThreadPool::StartWorkers()
+{
+    // Workers are placed on the CPUs node by node, and the ones on the same node are stolen from first
+    vector<pair<size_t, int>> places; // [node, cpu]
+    const vector<vector<int>> nodes = DetectNumaNodes();
+    for (size_t node = 0; node < nodes.size(); node++)
+    {
+        for (int cpu : nodes[node])
+        {
+            places.push_back({ node, cpu });
+        }
+    }
+
+    for (size_t i = 0; i < options.thread_count; i++)
+    {
+        workers.push_back(make_unique<Worker>());
+        if (options.pin_threads)
+            workers.back()->cpu = places[i % places.size()].second;
+    }
+    for (size_t i = 0; i < workers.size(); i++)
+    {
+        const size_t node = places[i % places.size()].first;
+        for (size_t step = 1; step < workers.size(); step++)
+        {
+            const size_t victim = (i + step) % workers.size();
+            if (places[victim % places.size()].first == node)
+                workers[i]->victims.push_back(victim);
+        }
+        for (size_t step = 1; step < workers.size(); step++)
+        {
+            const size_t victim = (i + step) % workers.size();
+            if (places[victim % places.size()].first != node)
+                workers[i]->victims.push_back(victim);
+        }
+    }
+    // Threads are started only once every deque exists, as any of them may be stolen from right away
+    for (size_t i = 0; i < workers.size(); i++)
+    {
+        workers[i]->thread = jthread([this, i](stop_token stop_token) { WorkerLoop(stop_token, i); });
+    }
+}
+void ThreadPool::Push(function<void()> task)
+{
+    if (current_pool == this)
+    {
+        Worker& worker = *workers[current_worker];
+        lock_guard lock(worker.mutex);
+        worker.tasks.push_back(move(task));
+    }
+    else
+    {
+        lock_guard lock(mutex);
+        shared_tasks.push_back(move(task));
+    }
+    queued_count++;
+    {
+        lock_guard lock(mutex);
+    } // Sleeping worker checks the count under the mutex, so it either sees the task or gets the notification
+    condition.notify_one();
+}
+bool ThreadPool::TryRunTask(size_t worker_index)
+{
+    function<void()> task;
+    Worker& worker = *workers[worker_index];
+    {
+        lock_guard lock(worker.mutex);
+        if (!worker.tasks.empty())
+        {
+            task = move(worker.tasks.back());
+            worker.tasks.pop_back();
+        }
+    }
+    if (!task)
+    {
+        lock_guard lock(mutex);
+        if (!shared_tasks.empty())
+        {
+            task = move(shared_tasks.front());
+            shared_tasks.pop_front();
+        }
+    }
+    for (size_t i = 0; !task && i < worker.victims.size(); i++)
+    {
+        Worker& victim = *workers[worker.victims[i]];
+        lock_guard lock(victim.mutex);
+        if (!victim.tasks.empty())
+        {
+            task = move(victim.tasks.front());
+            victim.tasks.pop_front();
+        }
+    }
+    if (!task)
+        return false;
+
+    queued_count--;
+    task();
+    return true;
+} // Own tasks are taken from the back, the newest ones, that are still in cache; stolen ones from the front, the oldest
+void ThreadPool::WorkerLoop(stop_token stop_token, size_t worker_index)
+{
+    current_pool = this;
+    current_worker = worker_index;
+    if (workers[worker_index]->cpu >= 0)
+        PinCurrentThread(workers[worker_index]->cpu);
+
+    while (true)
+    {
+        if (TryRunTask(worker_index))
+            continue;
+        unique_lock lock(mutex);
+        if (!condition.wait(lock, stop_token, [this]() { return queued_count > 0; }))
+            return; // Stop is requested and nothing is left to run
+    }
+}
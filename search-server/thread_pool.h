@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct ThreadPoolOptions
+{
+    size_t thread_count = std::thread::hardware_concurrency();
+    // Pins every worker to its own CPU. CPUs are taken NUMA node by node, so a pool smaller than the machine stays on as few nodes as possible
+    bool pin_threads = false;
+};
+
+// Work-stealing pool: every worker has its own deque, it runs the newest of its tasks first and, once the deque is empty, takes
+// the oldest tasks of the others, those on the same NUMA node first. Tasks, submitted from outside of the pool, go to a shared queue.
+// Threads are started by the first task. Destructor runs the tasks, that are queued already, and joins the workers
+class ThreadPool
+{
+public:
+    explicit ThreadPool(ThreadPoolOptions options = {});
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    ~ThreadPool();
+
+    void Submit(std::function<void()> task); // From a worker, the task goes to its own deque, where idle workers steal it
+    // Calls body(i) for every i in [0, count) and returns, once all of them are done. The calling thread takes part, and waits only
+    // for the calls, that are running already, so it may be nested into another ParallelFor without deadlocks and extra threads.
+    // The first exception of body is rethrown here
+    void ParallelFor(size_t count, const std::function<void(size_t)>& body);
+
+    // co_await pool.Schedule() moves the rest of the coroutine onto a worker thread
+    auto Schedule()
+    {
+        struct ScheduleAwaiter
+        {
+            ThreadPool& pool;
+
+            bool await_ready() const noexcept
+            {
+                return false;
+            }
+            void await_suspend(std::coroutine_handle<> handle)
+            {
+                pool.Submit([handle]() { handle.resume(); });
+            }
+            void await_resume() const noexcept {}
+        };
+        return ScheduleAwaiter{ *this };
+    }
+
+    size_t GetThreadCount() const;
+
+private:
+    struct Worker
+    {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+        std::vector<size_t> victims; // Order of stealing: workers on the same NUMA node first
+        int cpu = -1; // Pinned CPU, -1 if not pinned
+        std::jthread thread;
+    };
+
+    ThreadPoolOptions options;
+    std::once_flag start_flag;
+    std::vector<std::unique_ptr<Worker>> workers; // Empty, until the first task
+    std::mutex mutex; // Guards shared_tasks and sleeping of the workers
+    std::condition_variable_any condition;
+    std::deque<std::function<void()>> shared_tasks;
+    std::atomic<size_t> queued_count = 0; // Tasks in all the queues
+
+    void StartWorkers();
+    void Push(std::function<void()> task);
+    bool TryRunTask(size_t worker_index);
+    void WorkerLoop(std::stop_token stop_token, size_t worker_index);
+};